@@ -57,6 +57,12 @@ android {
     buildFeatures {
         compose = true
     }
+    // WADs are read a lump at a time, seeking about the file, which
+    // is slow on an asset aapt has deflated; packed WADs are
+    // compressed already. Store them as they are.
+    androidResources {
+        noCompress += "wad"
+    }
     externalNativeBuild {
         cmake {
             version = "3.22.1"
@@ -9,6 +9,8 @@
 
 #include "AndroidRenderer.h"
 #include "AndroidDriver.h"
+#include "z_zone.h"
+#include "g_game.h"
 
 static struct android_app *gapp;
 static int OGLESStarted = 0;
@@ -270,9 +272,14 @@ void handle_cmd(struct android_app *app, int32_t cmd)
             else
             {
                 SetupApplication();
+                G_ResumeGame();
             }
             break;
         case APP_CMD_TERM_WINDOW:
+            // We may be killed any time from now on: keep a snapshot
+            // to resume from on the next launch.
+            G_SuspendGame();
+
             if (egl_display != EGL_NO_DISPLAY)
             {
                 eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
@@ -288,6 +295,15 @@ void handle_cmd(struct android_app *app, int32_t cmd)
                 is_app_paused = 1;
             }
             break;
+        case APP_CMD_LOW_MEMORY:
+            // The system is short of memory: drop the cached lumps too.
+            Z_RequestTrim(Z_TRIM_PURGE);
+            break;
+        case APP_CMD_STOP:
+            // In the background we are first in line to be killed, so
+            // give back chunks the zone no longer needs.
+            Z_RequestTrim(Z_TRIM_RELEASE);
+            break;
         case APP_CMD_DESTROY:
             //This gets called initially after back.
             ANativeActivity_finish(gapp->activity);
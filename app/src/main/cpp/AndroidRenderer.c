@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <GLES2/gl2.h>
@@ -109,50 +110,62 @@ GLint imageProgramUT = 0;
 GLuint imageProgramTex = 0;
 GLuint circleProgram = -1;
 GLint circleProgramUX = -1;
-GLint circleProgramScrn = -1;
-GLint circleProgramLoc = -1;
-GLint circleProgramRad = -1;
+GLuint circleBuffer = 0;
 GLuint lastWidthResize = 454;
 GLuint lastHeightResize = 454;
 
+// The touch overlay is kept as a small table of circles. Each circle is
+// expanded into a quad whose vertices carry the circle colour and a local
+// -1..1 coordinate, so the whole overlay is one VBO and one draw call.
+// The buffer is only rebuilt when a circle or the screen size changes.
+
+typedef struct
+{
+    float x, y;
+    float u, v;
+    uint32_t color;
+} overlay_vertex_t;
+
+typedef struct
+{
+    bool visible;
+    int x, y;
+    float radius;
+    uint32_t color;
+} overlay_circle_t;
+
+static overlay_circle_t overlay_circles[OVERLAY_MAX_CIRCLES];
+static overlay_vertex_t overlay_vertices[OVERLAY_MAX_CIRCLES * 6];
+static int overlay_vertex_count = 0;
+static bool overlay_dirty = true;
+
 void SetupBatchInternal(void)
 {
     circleProgram = GLInternalLoadShader(
             "#version 100\n"
             "uniform vec4 xfrm;"
-            "attribute vec3 a0;"
+            "attribute vec4 a0;"
             "attribute vec4 a1;"
+            "varying mediump vec2 lc;"
             "varying lowp vec4 vc;"
-            "void main() { gl_Position = vec4(a0.xy*xfrm.xy+xfrm.zw, a0.z, 0.5); vc = a1; }",
+            "void main() { gl_Position = vec4(a0.xy*xfrm.xy+xfrm.zw, 0.0, 0.5); lc = a0.zw; vc = a1; }",
 
             "#version 100\n"
             "precision mediump float;"
+            "varying mediump vec2 lc;"
             "varying lowp vec4 vc;"
-            "uniform vec2 uRes;"
-            "uniform vec2 uLoc;"
-            "uniform float uRad;"
             "void main() {"
-            "    vec2 uv = (gl_FragCoord.xy / uRes - vec2(0.0, 1.0) + uLoc) * 2.0;\n"
-            "    float aspect = uRes.x / uRes.y;"
-            "    if (max(uRes.x, uRes.y) == uRes.y)"
-            "        uv.y /= aspect;"
-            "    else { uv.x *= aspect; }"
-            "    float distance = uRad/545.0 - length(uv);"
-            "    float alphaColour;"
-            "    if (distance > 0.0) {"
-            "        distance = 1.0;"
-            "        alphaColour = 1.0;"
-            "    } else { alphaColour = 0.0; }"
-            "    gl_FragColor = vec4(vec3(distance), alphaColour);"
-            "    gl_FragColor.rgb = vc.abg;"
+            "    gl_FragColor = vec4(vc.abg, step(dot(lc, lc), 1.0));"
             "}"
     );
 
     glUseProgram(circleProgram);
     circleProgramUX = glGetUniformLocation(circleProgram, "xfrm");
-    circleProgramScrn = glGetUniformLocation(circleProgram, "uRes");
-    circleProgramLoc = glGetUniformLocation(circleProgram, "uLoc");
-    circleProgramRad = glGetUniformLocation(circleProgram, "uRad");
+    glGenBuffers(1, &circleBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, circleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(overlay_vertices), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    overlay_dirty = true;
 
     imageProgram = GLInternalLoadShader(
             "uniform vec4 xfrm;"
@@ -185,36 +198,113 @@ void InternalResize(int x, int y)
     glViewport(0, 0, x, y);
     lastWidthResize = x;
     lastHeightResize = y;
+    overlay_dirty = true;
+}
+
+void SetOverlayCircle(int slot, int x, int y, float radius, uint32_t color)
+{
+    overlay_circle_t *c = &overlay_circles[slot];
+
+    if (c->visible && c->x == x && c->y == y
+     && c->radius == radius && c->color == color)
+    {
+        return;
+    }
+
+    c->visible = true;
+    c->x = x;
+    c->y = y;
+    c->radius = radius;
+    c->color = color;
+    overlay_dirty = true;
+}
+
+void HideOverlayCircle(int slot)
+{
+    if (overlay_circles[slot].visible)
+    {
+        overlay_circles[slot].visible = false;
+        overlay_dirty = true;
+    }
 }
 
-void RenderCircle(int x, int y, float radius, uint32_t color)
+static void BuildOverlay(void)
 {
+    // Circles are placed by the top left corner of a radius*2 box, but
+    // the visible disc has always been scaled against a 1090 pixel
+    // reference so that the buttons keep their size across watch faces.
+
+    float screen = (float) (lastWidthResize < lastHeightResize
+                            ? lastWidthResize : lastHeightResize);
+    overlay_vertex_t *v = overlay_vertices;
+
+    for (int i = 0; i < OVERLAY_MAX_CIRCLES; ++i)
+    {
+        overlay_circle_t *c = &overlay_circles[i];
+
+        if (!c->visible) continue;
+
+        float cx = (float) c->x + c->radius;
+        float cy = (float) c->y + c->radius;
+        float r = c->radius * screen / 1090.0f;
+        float e = 1.0f;
+
+        if (r > c->radius)
+        {
+            // Never draw past the original bounding box.
+            e = c->radius / r;
+            r = c->radius;
+        }
+
+        const float corners[6][2] = {
+                { -1.0f, -1.0f }, { 1.0f, -1.0f }, { -1.0f, 1.0f },
+                { -1.0f,  1.0f }, { 1.0f, -1.0f }, {  1.0f, 1.0f }
+        };
+
+        for (int j = 0; j < 6; ++j, ++v)
+        {
+            v->x = cx + corners[j][0] * r;
+            v->y = cy + corners[j][1] * r;
+            v->u = corners[j][0] * e;
+            v->v = corners[j][1] * e;
+            v->color = c->color;
+        }
+    }
+
+    overlay_vertex_count = v - overlay_vertices;
+
     glUseProgram(circleProgram);
     glUniform4f(circleProgramUX, 1.0f / lastWidthResize, -1.0f / lastHeightResize, -0.5f, 0.5f);
-    glUniform2f(circleProgramScrn, (float) lastWidthResize, (float) lastHeightResize);
-    float ux = (float) x+radius;
-    float uy = (float) y+radius;
-    glUniform2f(circleProgramLoc, -ux / lastWidthResize, uy / lastHeightResize);
-    glUniform1f(circleProgramRad, radius);
-
-    float x1 = (float) x, y1 = (float) y;
-    float x2 = (float) x+radius*2, y2 = (float) y+radius*2;
-
-    float fv[18];
-    for (int i = 0; i < 18; ++i) fv[i] = 0.0f; // we need to fill with 0 because it causes errors
-    fv[0] = x1; fv[1] = y1;
-    fv[3] = x2; fv[4] = y1;
-    fv[6] = x1; fv[7] = y2;
-    fv[9] = x1; fv[10] = y2;
-    fv[12] = x2; fv[13] = y1;
-    fv[15] = x2; fv[16] = y2;
-
-    uint32_t col[6];
-    for (int i = 0; i < 6; ++i) col[i] = color;
-
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, fv);
-    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 0, col);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindBuffer(GL_ARRAY_BUFFER, circleBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    overlay_vertex_count * sizeof(overlay_vertex_t), overlay_vertices);
+
+    overlay_dirty = false;
+}
+
+void RenderOverlay(void)
+{
+    if (overlay_dirty)
+    {
+        BuildOverlay();
+    }
+    else
+    {
+        glUseProgram(circleProgram);
+        glBindBuffer(GL_ARRAY_BUFFER, circleBuffer);
+    }
+
+    if (overlay_vertex_count > 0)
+    {
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(overlay_vertex_t),
+                              (const void *) 0);
+        glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(overlay_vertex_t),
+                              (const void *) offsetof(overlay_vertex_t, color));
+        glDrawArrays(GL_TRIANGLES, 0, overlay_vertex_count);
+    }
+
+    // RenderImage uses client side arrays.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void RenderImage(uint32_t *data, int x, int y, int w, int h)
@@ -15,7 +15,13 @@ void GetScreenDimensions(int *x, int *y);
 void SetupApplication(void);
 void HandleInput(void);
 
-void RenderCircle(int x, int y, float radius, uint32_t color);
+// Touch overlay. Circles are set by slot and only re-uploaded to the
+// GPU when they change; RenderOverlay draws them all in one call.
+#define OVERLAY_MAX_CIRCLES 8
+
+void SetOverlayCircle(int slot, int x, int y, float radius, uint32_t color);
+void HideOverlayCircle(int slot);
+void RenderOverlay(void);
 void RenderImage(uint32_t *data, int x, int y, int w, int h);
 
 void ClearFrame(void);
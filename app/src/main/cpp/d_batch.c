@@ -0,0 +1,381 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Playing many demos at once, in worker processes.
+//
+//	With -batchdemo, startup (WADs, textures, R_Init and the rest)
+//	is done once, and then a worker process is forked for each
+//	demo.  The workers share everything loaded until they write to
+//	it, so starting one costs next to nothing.  Each plays its demo
+//	as fast as it can without drawing, hashes the level as it was
+//	left, and passes the tics, the hash and the time taken back
+//	through a pipe.  When all have finished, a line is printed for
+//	each demo, in the order given:
+//
+//	    demo tics hash ms
+//
+//	so that the output of two builds can be compared with diff
+//	(ignoring the last column).  The exit status is 1 if any demo
+//	could not be played.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32) && !defined(__DJGPP__) && !defined(__EMSCRIPTEN__)
+#define HAVE_FORK
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "d_batch.h"
+#include "d_loop.h"
+#include "g_game.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "p_hash.h"
+#include "p_local.h"
+#include "sha1.h"
+#include "w_wad.h"
+
+#ifdef HAVE_FORK
+
+// What a worker sends back.
+
+typedef struct
+{
+    int tics;
+    int ms;
+    boolean hashed;
+    sha1_digest_t hash;
+} batchresult_t;
+
+typedef struct
+{
+    pid_t pid;
+    int fd;
+    int demo;
+} batchworker_t;
+
+typedef struct
+{
+    batchresult_t result;
+    boolean played;
+    int status;
+} batchdemo_t;
+
+//
+// Hash the level with the state hashes of p_hash.c. A savegame
+// snapshot will not do, as it holds pointers, which differ from
+// run to run.
+//
+static void HashLevel(batchresult_t *result)
+{
+    sha1_context_t sha1;
+
+    SHA1_Init(&sha1);
+    P_HashLevel(&sha1);
+    SHA1_Final(result->hash, &sha1);
+
+    result->hashed = true;
+}
+
+//
+// Play one demo, in a worker. The demo is loaded as -playdemo would
+// load it, but only into this process.
+//
+static void PlayDemo(char *name, batchresult_t *result)
+{
+    static char lumpname[9];
+    char file[256];
+    int start;
+
+    if (M_StringEndsWith(name, ".lmp"))
+    {
+        M_StringCopy(file, name, sizeof(file));
+    }
+    else
+    {
+        M_snprintf(file, sizeof(file), "%s.lmp", name);
+    }
+
+    if (W_AddFile(file) != NULL)
+    {
+        memcpy(lumpname, lumpinfo[numlumps - 1].name, 8);
+        lumpname[8] = '\0';
+    }
+    else
+    {
+        M_StringCopy(lumpname, name, sizeof(lumpname));
+    }
+
+    nodrawers = true;
+    singledemo = false;
+
+    // Until the demo loads a level, there is nothing to hash.
+    gamestate = GS_DEMOSCREEN;
+
+    start = I_GetTimeMS();
+
+    G_DeferedPlayDemo(lumpname);
+
+    do
+    {
+        G_Ticker();
+        ++gametic;
+        ++result->tics;
+    } while (demoplayback);
+
+    // Levels are kept through the intermission and finale, so a demo
+    // that ends on an exit is hashed too.
+    if (gamestate != GS_DEMOSCREEN)
+    {
+        HashLevel(result);
+    }
+
+    result->ms = I_GetTimeMS() - start;
+}
+
+static void StartWorker(batchworker_t *worker, int demo, char *name)
+{
+    batchresult_t result;
+    int fds[2];
+
+    if (pipe(fds) != 0)
+    {
+        I_Error("D_BatchDemos: Unable to create a pipe");
+    }
+
+    // Or the workers write out whatever is still in the buffers.
+    fflush(stdout);
+    fflush(stderr);
+
+    worker->pid = fork();
+
+    if (worker->pid < 0)
+    {
+        I_Error("D_BatchDemos: Unable to start a worker");
+    }
+
+    if (worker->pid == 0)
+    {
+        close(fds[0]);
+
+        // The parent has the screen; workers keep quiet and leave
+        // it alone when they exit, even on an error. No sight
+        // threads, as there is a worker for every core.
+        I_ClearAtExit();
+
+        if (freopen("/dev/null", "w", stdout) == NULL)
+        {
+            _exit(2);
+        }
+
+        P_SetSightThreads(0);
+
+        memset(&result, 0, sizeof(result));
+        PlayDemo(name, &result);
+
+        if (write(fds[1], &result, sizeof(result)) != sizeof(result))
+        {
+            _exit(2);
+        }
+
+        _exit(0);
+    }
+
+    close(fds[1]);
+    worker->fd = fds[0];
+    worker->demo = demo;
+}
+
+static void FinishWorker(batchworker_t *worker, batchdemo_t *demo, int status)
+{
+    demo->status = status;
+    demo->played = WIFEXITED(status) && WEXITSTATUS(status) == 0
+                && read(worker->fd, &demo->result, sizeof(demo->result))
+                   == sizeof(demo->result);
+
+    close(worker->fd);
+    worker->pid = 0;
+}
+
+static void PrintResult(char *name, batchdemo_t *demo)
+{
+    char hash[sizeof(sha1_digest_t) * 2 + 1];
+    int i;
+
+    if (!demo->played)
+    {
+        if (WIFSIGNALED(demo->status))
+        {
+            printf("%s failed (signal %i)\n", name, WTERMSIG(demo->status));
+        }
+        else
+        {
+            printf("%s failed (exit status %i)\n",
+                   name, WEXITSTATUS(demo->status));
+        }
+
+        return;
+    }
+
+    if (demo->result.hashed)
+    {
+        for (i = 0; i < (int) sizeof(sha1_digest_t); ++i)
+        {
+            M_snprintf(hash + i * 2, 3, "%02x", demo->result.hash[i]);
+        }
+    }
+    else
+    {
+        M_StringCopy(hash, "-", sizeof(hash));
+    }
+
+    printf("%s %i %s %i\n", name, demo->result.tics, hash, demo->result.ms);
+}
+
+void D_BatchDemos (int arg)
+{
+    batchworker_t *workers;
+    batchdemo_t *demos;
+    int numdemos, jobs;
+    int next, running, failed;
+    int start;
+    int status;
+    pid_t pid;
+    int i, p;
+
+    for (numdemos = 0; arg + numdemos < myargc
+                    && myargv[arg + numdemos][0] != '-'; ++numdemos);
+
+    if (numdemos == 0)
+    {
+        I_Error("D_BatchDemos: No demos given");
+    }
+
+    //!
+    // @arg <n>
+    // @category demo
+    //
+    // Run up to n workers at once with -batchdemo. The default is one
+    // for each processor.
+    //
+
+    p = M_CheckParmWithArgs("-jobs", 1);
+
+    if (p)
+    {
+        jobs = atoi(myargv[p + 1]);
+    }
+    else
+    {
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+
+    if (jobs < 1)
+    {
+        jobs = 1;
+    }
+
+    workers = calloc(jobs, sizeof(batchworker_t));
+    demos = calloc(numdemos, sizeof(batchdemo_t));
+
+    if (workers == NULL || demos == NULL)
+    {
+        I_Error("D_BatchDemos: Out of memory");
+    }
+
+    printf("D_BatchDemos: Playing %i demos, %i at a time.\n",
+           numdemos, jobs);
+
+    start = I_GetTimeMS();
+    next = 0;
+    running = 0;
+
+    while (next < numdemos || running > 0)
+    {
+        for (i = 0; i < jobs && next < numdemos; ++i)
+        {
+            if (workers[i].pid == 0)
+            {
+                StartWorker(&workers[i], next, myargv[arg + next]);
+                ++next;
+                ++running;
+            }
+        }
+
+        pid = waitpid(-1, &status, 0);
+
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            I_Error("D_BatchDemos: Lost track of the workers");
+        }
+
+        for (i = 0; i < jobs; ++i)
+        {
+            if (workers[i].pid == pid)
+            {
+                FinishWorker(&workers[i], &demos[workers[i].demo], status);
+                --running;
+                break;
+            }
+        }
+    }
+
+    failed = 0;
+
+    for (i = 0; i < numdemos; ++i)
+    {
+        PrintResult(myargv[arg + i], &demos[i]);
+
+        if (!demos[i].played)
+        {
+            ++failed;
+        }
+    }
+
+    printf("D_BatchDemos: %i demos played, %i failed, in %i ms.\n",
+           numdemos - failed, failed, I_GetTimeMS() - start);
+
+    free(workers);
+    free(demos);
+
+    I_Quit();
+    exit(failed > 0 ? 1 : 0);
+}
+
+#else
+
+void D_BatchDemos (int arg)
+{
+    I_Error("D_BatchDemos: -batchdemo needs fork(), "
+            "which this system does not have");
+}
+
+#endif
+
@@ -0,0 +1,29 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Playing many demos at once, in worker processes.
+//
+
+
+#ifndef __D_BATCH__
+#define __D_BATCH__
+
+// Play the demos named in myargv from the given argument on, each
+// in a process forked from this one, and report how they went.
+// Called once startup is done. Never returns.
+
+void D_BatchDemos (int arg);
+
+#endif
+
@@ -32,10 +32,12 @@
 #include "doomfeatures.h"
 #include "sounds.h"
 
+#include "d_batch.h"
 #include "d_iwad.h"
 
 #include "z_zone.h"
 #include "w_main.h"
+#include "w_prefetch.h"
 #include "w_wad.h"
 #include "s_sound.h"
 #include "v_video.h"
@@ -48,6 +50,7 @@
 #include "m_controls.h"
 #include "m_misc.h"
 #include "m_menu.h"
+#include "p_hash.h"
 #include "p_saveg.h"
 
 #include "i_system.h"
@@ -345,8 +348,96 @@ boolean D_GrabMouseCallback(void)
     return (gamestate == GS_LEVEL) && !demoplayback && !advancedemo;
 }
 
+//
+// STARTUP TRACE
+// Each startup phase is timed; with -startuptrace the timings are
+// printed when the main loop starts.  Phases may run on other
+// threads, but are only started and printed from this one.
+// Lump reads take the zone lock, so while threaded phases overlap
+// the rest, their reads do not; the reads made meanwhile are
+// counted to show how much of the startup that was.
+//
+#define MAXSTARTUPPHASES	32
+
+typedef struct
+{
+    char*	name;
+    boolean	threaded;
+    int		start;		// ms since launch
+    int		end;
+} startupphase_t;
+
+static startupphase_t	startupphases[MAXSTARTUPPHASES];
+static int		numstartupphases;
+static int		threadedreads;		// lump reads while threaded
+static int		threadedreadbytes;
+
+static startupphase_t *D_StartPhase(char *name)
+{
+    startupphase_t *phase;
+
+    if (numstartupphases == MAXSTARTUPPHASES)
+    {
+        // keep timing, but in the last slot
+        --numstartupphases;
+    }
+
+    phase = &startupphases[numstartupphases++];
+    phase->name = name;
+    phase->threaded = false;
+    phase->start = I_GetTimeMS();
+    phase->end = phase->start;
+
+    return phase;
+}
+
+static void D_EndPhase(startupphase_t *phase)
+{
+    phase->end = I_GetTimeMS();
+}
+
+static void D_PrintStartupTrace(void)
+{
+    startupphase_t *phase;
+    int i;
+
+    //!
+    // Print how long each startup phase took once the game
+    // reaches its main loop.
+    //
+
+    if (!M_ParmExists("-startuptrace"))
+    {
+        return;
+    }
+
+    printf("Startup trace (ms since launch):\n");
+
+    for (i = 0; i < numstartupphases; ++i)
+    {
+        phase = &startupphases[i];
+
+        printf("  %-16s %6i %6i %6i%s\n", phase->name,
+               phase->start, phase->end, phase->end - phase->start,
+               phase->threaded ? "  (thread*)" : "");
+    }
+
+    if (threadedreads > 0)
+    {
+        printf("  * overlaps the phases around it, except that the %i "
+               "lump reads (%i KB)\n"
+               "    made meanwhile hold the zone lock and ran one at "
+               "a time\n",
+               threadedreads, threadedreadbytes / 1024);
+    }
+
+    printf("  %-16s %6i\n", "main loop", I_GetTimeMS());
+}
+
 void D_DoomLoop(void)
 {
+    startupphase_t *phase;
+
     if (bfgedition && (demorecording || (gameaction == ga_playdemo) || netgame))
     {
         printf(" WARNING: You are playing using one of the Doom Classic\n"
@@ -361,6 +452,8 @@ void D_DoomLoop(void)
 
     TryRunTics();
 
+    phase = D_StartPhase("I_InitGraphics");
+
     I_SetWindowTitle(gamedescription);
     I_SetGrabMouseCallback(D_GrabMouseCallback);
     I_InitGraphics();
@@ -370,11 +463,17 @@ void D_DoomLoop(void)
 
     D_StartGameLoop();
 
+    D_EndPhase(phase);
+    D_PrintStartupTrace();
+
     if (testcontrols)
         wipegamestate = gamestate;
 
     while (1)
     {
+        // give memory back if the system asked for it
+        Z_CheckTrim();
+
         // frame syncronous IO operations
         I_StartFrame();
 
@@ -963,19 +1062,61 @@ static void D_Endoom(void)
     exit(0);
 }
 
+//
+// Sound and the heads up font only need the WAD, so they are
+// loaded on threads while the refresh and playloop are set up.
+//
+static void D_InitSound(void *arg)
+{
+    startupphase_t *phase = arg;
+
+    phase->start = I_GetTimeMS();
+    S_Init(sfxVolume * 8, musicVolume * 8);
+    phase->end = I_GetTimeMS();
+}
+
+static void D_InitHU(void *arg)
+{
+    startupphase_t *phase = arg;
+
+    phase->start = I_GetTimeMS();
+    HU_Init();
+    phase->end = I_GetTimeMS();
+}
+
 void D_DoomMain(void)
 {
     int p;
     char file[256];
     char demolumpname[9];
+    startupphase_t *phase;
+    i_thread_t *soundthread;
+    i_thread_t *huthread;
 
     I_AtExit(D_Endoom, false);
 
     // print banner
     I_PrintBanner(PACKAGE_NAME);
 
+    phase = D_StartPhase("Z_Init");
     printf("Z_Init: Init zone memory allocation daemon. \n");
     Z_Init();
+    D_EndPhase(phase);
+
+    //!
+    // @arg <file>
+    //
+    // Record zone memory statistics (per tag and per call site usage,
+    // purges, fragmentation over time and a final heap map) and write
+    // them to the given file as JSON on exit.
+    //
+
+    p = M_CheckParmWithArgs("-zonestats", 1);
+
+    if (p)
+    {
+        Z_StartTelemetry(myargv[p+1]);
+    }
 
     //!
     // @vanilla
@@ -1091,10 +1232,12 @@ void D_DoomMain(void)
     // init subsystems
 
     // Load configuration files before initialising other subsystems.
+    phase = D_StartPhase("M_LoadDefaults");
     printf("M_LoadDefaults: Load system defaults.\n");
     M_SetConfigFilenames("default.cfg", PROGRAM_PREFIX "doom.cfg");
     D_BindVariables();
     M_LoadDefaults();
+    D_EndPhase(phase);
 
     // Save configuration at exit.
     I_AtExit(M_SaveDefaults, false);
@@ -1112,6 +1255,7 @@ void D_DoomMain(void)
 
     modifiedgame = false;
 
+    phase = D_StartPhase("W_Init");
     printf("W_Init: Init WADfiles.\n");
     D_AddFile(iwadfile);
 
@@ -1219,6 +1363,11 @@ void D_DoomMain(void)
 
     // Generate the WAD hash table.  Speed things up a bit.
     W_GenerateHashTable();
+    D_EndPhase(phase);
+
+    // Lump numbers are settled now, so traces and plans can be used.
+    W_InitPrefetch();
+    W_BeginLoadPhase("STARTUP");
 
     // Set the gamedescription string. This is only possible now that
     // we've finished loading Dehacked patches.
@@ -1282,8 +1431,10 @@ void D_DoomMain(void)
         I_PrintDivider();
     }
 
+    phase = D_StartPhase("I_InitSound");
     printf("I_Init: Setting up machine state.\n");
     I_InitSound(true);
+    D_EndPhase(phase);
 
     // Initial netgame startup. Connect to server etc.
     D_ConnectNetGame();
@@ -1423,28 +1574,59 @@ void D_DoomMain(void)
         startloadgame = -1;
     }
 
+    phase = D_StartPhase("M_Init");
     printf("M_Init: Init miscellaneous info.\n");
     M_Init();
+    D_EndPhase(phase);
+
+    // The zone serializes allocations, and lump reads, until the
+    // threads are done.
+    Z_SetThreaded(true);
+    threadedreads = numlumpreads;
+    threadedreadbytes = lumpreadbytes;
 
+    printf("S_Init: Setting up sound.\n");
+    phase = D_StartPhase("S_Init");
+    phase->threaded = true;
+    soundthread = I_StartThread(D_InitSound, phase);
+
+    printf("HU_Init: Setting up heads up display.\n");
+    phase = D_StartPhase("HU_Init");
+    phase->threaded = true;
+    huthread = I_StartThread(D_InitHU, phase);
+
+    phase = D_StartPhase("R_Init");
     printf("R_Init: Init DOOM refresh daemon - ");
     R_Init();
+    D_EndPhase(phase);
 
+    // needs the textures, flats and sprite lumps
+    phase = D_StartPhase("P_Init");
     printf("\nP_Init: Init Playloop state.\n");
     P_Init();
+    D_EndPhase(phase);
 
-    printf("S_Init: Setting up sound.\n");
-    S_Init(sfxVolume * 8, musicVolume * 8);
-
+    phase = D_StartPhase("D_CheckNetGame");
     printf("D_CheckNetGame: Checking network game status.\n");
     D_CheckNetGame();
+    D_EndPhase(phase);
 
     PrintGameVersion();
 
-    printf("HU_Init: Setting up heads up display.\n");
-    HU_Init();
-
+    // needs consoleplayer, from D_CheckNetGame
+    phase = D_StartPhase("ST_Init");
     printf("ST_Init: Init status bar.\n");
     ST_Init();
+    D_EndPhase(phase);
+
+    I_WaitThread(soundthread);
+    I_WaitThread(huthread);
+
+    Z_SetThreaded(false);
+    threadedreads = numlumpreads - threadedreads;
+    threadedreadbytes = lumpreadbytes - threadedreadbytes;
+
+    W_EndLoadPhase();
 
     // If Doom II without a MAP01 lump, this is a store demo.
     // Moved this here so that MAP01 isn't constantly looked up
@@ -1469,11 +1651,47 @@ void D_DoomMain(void)
         autostart = true;
     }
 
+    //!
+    // @arg <demo> [<demo> ...]
+    // @category demo
+    //
+    // Play back the given demos, each in a process of its own forked
+    // from this one once startup is done, and print the tics, final
+    // state hash and time taken for each. Use -jobs to set how many
+    // run at once.
+    //
+
+    p = M_CheckParmWithArgs("-batchdemo", 1);
+
+    if (p)
+    {
+        D_BatchDemos(p + 1);  // never returns
+    }
+
+    // Only now, as batch workers would all write to the one stream.
+    P_InitStateHash();
+
     p = M_CheckParmWithArgs("-playdemo", 1);
     if (p)
     {
         singledemo = true; // quit after one demo
         G_DeferedPlayDemo(demolumpname);
+
+        //!
+        // @arg <tic>
+        // @category demo
+        //
+        // Skip ahead to the given tic when playing back a demo
+        // with -playdemo.
+        //
+
+        p = M_CheckParmWithArgs("-seektic", 1);
+
+        if (p)
+        {
+            G_SeekDemo(atoi(myargv[p+1]));
+        }
+
         D_DoomLoop();  // never returns
     }
 
@@ -1490,6 +1708,11 @@ void D_DoomMain(void)
         M_StringCopy(file, P_SaveGameFile(startloadgame), sizeof(file));
         G_LoadGame(file);
     }
+    else if (!autostart && !netgame)
+    {
+        // Go straight back into a game suspended by the last run.
+        G_LoadSuspendedGame();
+    }
 
     if (gameaction != ga_loadgame)
     {
@@ -6,6 +6,8 @@
 
 pixel_t* DG_ScreenBuffer = NULL;
 
+struct FB_ScreenInfo DG_ScreenInfo;
+
 void M_FindResponseFile(void);
 void D_DoomMain (void);
 
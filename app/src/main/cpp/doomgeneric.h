@@ -26,6 +26,32 @@ typedef uint32_t pixel_t;
 
 extern pixel_t* DG_ScreenBuffer;
 
+struct FB_BitField {
+    uint32_t offset; /* beginning of bitfield */
+    uint32_t length; /* length of bitfield */
+};
+
+struct FB_ScreenInfo {
+    uint32_t xres; /* visible resolution */
+    uint32_t yres;
+
+    uint32_t bits_per_pixel; /* guess what */
+    uint32_t line_length;    /* bytes from one line to the next */
+
+    /* >1 = FOURCC */
+    struct FB_BitField red; /* bitfield in s_Fb mem if true color, */
+    struct FB_BitField green; /* else only length is significant */
+    struct FB_BitField blue;
+    struct FB_BitField transp; /* transparency */
+};
+
+/* How I_FinishUpdate lays out pixels in DG_ScreenBuffer. DG_Init may
+ * fill this in, and point DG_ScreenBuffer at memory the display reads
+ * from, to be drawn into directly; if xres is left at 0 the buffer is
+ * DOOMGENERIC_RESX x DOOMGENERIC_RESY at 32 bits per pixel. The frame
+ * is scaled by the largest whole number that fits and centred. */
+extern struct FB_ScreenInfo DG_ScreenInfo;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,6 +15,16 @@ static unsigned short s_KeyQueue[KEYQUEUE_SIZE];
 static unsigned int s_KeyQueueWriteIndex = 0;
 static unsigned int s_KeyQueueReadIndex = 0;
 
+// Overlay slots; the first three match the VirtualButton ids.
+enum
+{
+    OVERLAY_ENTER,
+    OVERLAY_FIRE,
+    OVERLAY_USE,
+    OVERLAY_JOYSTICK_BASE,
+    OVERLAY_JOYSTICK_KNOB,
+};
+
 static bool pointer_touched_in(int x, int y, int x2, int y2, int *id)
 {
     for (int i = 0; i < 8; ++i)
@@ -60,9 +70,9 @@ static void VirtualButton(int x, int y, int button_id, unsigned char keycode)
     }
 
     if (pressed[button_id])
-        RenderCircle(x, y, 50, 0x4c4c4cff);
+        SetOverlayCircle(button_id, x, y, 50, 0x4c4c4cff);
     else
-        RenderCircle(x, y, 50, 0x808080ff);
+        SetOverlayCircle(button_id, x, y, 50, 0x808080ff);
 }
 
 static bool pointer_touched_within_x_bound(int x, bool less, int *id) {
@@ -144,11 +154,11 @@ static void VirtualJoystick(void)
     static bool backward = false;
     static bool left = false;
     static bool right = false;
-    RenderCircle(-50, screen_y - 200, 100, 0x4c4c4cff);
+    SetOverlayCircle(OVERLAY_JOYSTICK_BASE, -50, screen_y - 200, 100, 0x4c4c4cff);
     int id;
     if (pointer_touched_in(screen_x/18, screen_y-300, screen_x/18+200, screen_y-100, &id))
     {
-        RenderCircle(motion_x[id] - 80, motion_y[id] - 80, 80, 0x808080ff);
+        SetOverlayCircle(OVERLAY_JOYSTICK_KNOB, motion_x[id] - 80, motion_y[id] - 80, 80, 0x808080ff);
         if (motion_y[id] < screen_y-250) {
             if (!forward) {
                 addKeyToQueue(1, KEY_UPARROW);
@@ -193,7 +203,7 @@ static void VirtualJoystick(void)
     }
     else
     {
-        RenderCircle(screen_x / 16, screen_y - 280, 80, 0x808080ff);
+        SetOverlayCircle(OVERLAY_JOYSTICK_KNOB, screen_x / 16, screen_y - 280, 80, 0x808080ff);
 
         if (forward) {
             addKeyToQueue(0, KEY_UPARROW);
@@ -232,12 +242,14 @@ void DG_DrawFrame(void)
     Movement();
 
     // if (menuactive)
-        VirtualButton(screen_x-200, screen_y-225, 0, KEY_ENTER);
+        VirtualButton(screen_x-200, screen_y-225, OVERLAY_ENTER, KEY_ENTER);
     //else
-        VirtualButton(screen_x-200, screen_y-320, 1, KEY_FIRE);
+        VirtualButton(screen_x-200, screen_y-320, OVERLAY_FIRE, KEY_FIRE);
 
-    VirtualButton(screen_x-400, screen_y-300, 2, KEY_USE);
+    VirtualButton(screen_x-400, screen_y-300, OVERLAY_USE, KEY_USE);
     //VirtualButton(screen_x-55, screen_y-100, 2, KEY_ESCAPE);
+
+    RenderOverlay();
     HandleInput();
     SwapBuffers();
 }
@@ -46,6 +46,7 @@
 
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
@@ -76,6 +77,14 @@ static struct timeval startTime;
 static uint8_t *fbPtr;
 static int fbFd;
 static unsigned int fbWidth, fbHeight, fbStride, fbBytesPerPixel, fbOffsetX, fbOffsetY;
+static size_t fbMapSize;
+static struct fb_var_screeninfo fbInfo, fbOrigInfo;
+
+// with page flipping, frames are drawn into the page not on screen
+// and then panned to
+static bool fbPageFlip = false;
+static bool fbVsync = false;
+static unsigned int fbPage = 0;
 
 // input stuff
 static int numInputFds = 0;
@@ -404,9 +413,49 @@ static void checkInputDevs() {
 	closedir(dir);
 }
 
+static void restoreFramebuffer(void) {
+	if (fbPageFlip)
+		ioctl(fbFd, FBIOPUT_VSCREENINFO, &fbOrigInfo);
+}
+
+// Where I_FinishUpdate draws the given page: the frame is
+// centred in it.
+static pixel_t *pagePtr(unsigned int page) {
+	return (pixel_t *)(fbPtr + page * fbHeight * fbStride + fbOffsetY + fbOffsetX);
+}
+
+// Make a second page below the screen to draw into, if the
+// driver can pan between them.
+static bool setupPageFlip(struct fb_fix_screeninfo *finfo) {
+	if (finfo->ypanstep == 0) {
+		printf("DG_Init: framebuffer can't pan, not page flipping\n");
+		return false;
+	}
+
+	if (fbInfo.yres_virtual < fbInfo.yres * 2) {
+		fbInfo.yres_virtual = fbInfo.yres * 2;
+		fbInfo.yoffset = 0;
+
+		if (ioctl(fbFd, FBIOPUT_VSCREENINFO, &fbInfo) != 0
+		 || ioctl(fbFd, FBIOGET_VSCREENINFO, &fbInfo) != 0
+		 || fbInfo.yres_virtual < fbInfo.yres * 2) {
+			printf("DG_Init: no room for a second page, not page flipping\n");
+			ioctl(fbFd, FBIOPUT_VSCREENINFO, &fbOrigInfo);
+			ioctl(fbFd, FBIOGET_VSCREENINFO, &fbInfo);
+			return false;
+		}
+
+		// the stride may have changed with the virtual size
+		if (ioctl(fbFd, FBIOGET_FSCREENINFO, finfo) == 0)
+			fbStride = finfo->line_length;
+	}
+
+	return true;
+}
+
 void DG_Init() {
-	int ret;
-	struct fb_var_screeninfo info;
+	int ret, p;
+	unsigned int scale;
 	struct fb_fix_screeninfo finfo;
 
 	//
@@ -417,10 +466,15 @@ void DG_Init() {
 		I_Error("Failed to open /dev/fb0: %s", strerror(errno));
 
 	// get info
-	ret = ioctl(fbFd, FBIOGET_VSCREENINFO, &info);
+	ret = ioctl(fbFd, FBIOGET_VSCREENINFO, &fbInfo);
 	if (ret != 0)
 		I_Error("Failed to get framebuffer info: %s", strerror(errno));
 
+	fbOrigInfo = fbInfo;
+	fbWidth = fbInfo.xres;
+	fbHeight = fbInfo.yres;
+	fbBytesPerPixel = fbInfo.bits_per_pixel / 8;
+
 	// get other info (this can optionally fail, since we can guess the stride)
 	ret = ioctl(fbFd, FBIOGET_FSCREENINFO, &finfo);
 	if (ret != 0) {
@@ -431,22 +485,80 @@ void DG_Init() {
 		fbStride = finfo.line_length;
 	}
 
-	fbWidth = info.xres;
-	fbHeight = info.yres;
-	fbBytesPerPixel = info.bits_per_pixel / 8;
+	//!
+	// @platform linuxvt
+	//
+	// Draw each frame off screen and pan the framebuffer to it, so
+	// a half drawn frame is never seen.
+	//
+	if (M_ParmExists("-pageflip") && ret == 0)
+		fbPageFlip = setupPageFlip(&finfo);
+
+	//!
+	// @platform linuxvt
+	//
+	// Wait for the vertical blank before showing a frame.
+	//
+	fbVsync = M_ParmExists("-vsync");
+
+	//!
+	// @arg <n>
+	// @platform linuxvt
+	//
+	// Scale the picture up by a whole number (0 fills the screen).
+	//
+	scale = 1;
+	p = M_CheckParmWithArgs("-scale", 1);
+	if (p > 0)
+		scale = atoi(myargv[p + 1]);
+
+	if (scale == 0 || DOOMGENERIC_RESX * scale > fbWidth || DOOMGENERIC_RESY * scale > fbHeight) {
+		scale = fbWidth / DOOMGENERIC_RESX;
+		if (fbHeight / DOOMGENERIC_RESY < scale)
+			scale = fbHeight / DOOMGENERIC_RESY;
+		if (scale < 1)
+			scale = 1;
+	}
 
 	// to center the image on screen
-	fbOffsetX = ((fbWidth - DOOMGENERIC_RESX) / 2) * fbBytesPerPixel;
-	fbOffsetY = ((fbHeight - DOOMGENERIC_RESY) / 2) * fbStride;
+	fbOffsetX = ((fbWidth - DOOMGENERIC_RESX * scale) / 2) * fbBytesPerPixel;
+	fbOffsetY = ((fbHeight - DOOMGENERIC_RESY * scale) / 2) * fbStride;
 
-	fbPtr = mmap(NULL, fbStride * fbHeight, PROT_READ | PROT_WRITE,
+	fbMapSize = (size_t)fbStride * fbHeight * (fbPageFlip ? 2 : 1);
+	fbPtr = mmap(NULL, fbMapSize, PROT_READ | PROT_WRITE,
 			MAP_SHARED, fbFd, 0);
 
-	if (!fbPtr)
+	if (fbPtr == MAP_FAILED)
 		I_Error("Failed to mmap /dev/fb0: %s", strerror(errno));
 
 	// clear the screen
-	memset(fbPtr, 0, fbStride * fbHeight);
+	memset(fbPtr, 0, fbMapSize);
+
+	I_AtExit(restoreFramebuffer, true);
+
+	// I_FinishUpdate converts frames straight into the framebuffer,
+	// in its own pixel format; the rest of the screen is left alone.
+	free(DG_ScreenBuffer);
+	fbPage = fbPageFlip ? 1 : 0;
+	DG_ScreenBuffer = pagePtr(fbPage);
+
+	memset(&DG_ScreenInfo, 0, sizeof(DG_ScreenInfo));
+	DG_ScreenInfo.xres = DOOMGENERIC_RESX * scale;
+	DG_ScreenInfo.yres = DOOMGENERIC_RESY * scale;
+	DG_ScreenInfo.bits_per_pixel = fbInfo.bits_per_pixel;
+	DG_ScreenInfo.line_length = fbStride;
+	DG_ScreenInfo.red.offset = fbInfo.red.offset;
+	DG_ScreenInfo.red.length = fbInfo.red.length;
+	DG_ScreenInfo.green.offset = fbInfo.green.offset;
+	DG_ScreenInfo.green.length = fbInfo.green.length;
+	DG_ScreenInfo.blue.offset = fbInfo.blue.offset;
+	DG_ScreenInfo.blue.length = fbInfo.blue.length;
+	DG_ScreenInfo.transp.offset = fbInfo.transp.offset;
+	DG_ScreenInfo.transp.length = fbInfo.transp.length;
+
+	printf("DG_Init: %ux%u framebuffer, %u bpp, scale %u%s%s\n",
+	       fbWidth, fbHeight, fbInfo.bits_per_pixel, scale,
+	       fbPageFlip ? ", page flipping" : "", fbVsync ? ", vsync" : "");
 
 	//
 	// set up input
@@ -461,15 +573,20 @@ void DG_Init() {
 }
 
 void DG_DrawFrame() {
-	// we need to do it line-by-line like this to account for the
-	// fact that the system framebuffer resolution is very likely
-	// larger than the doomgeneric render resolution.
-	for (int line = 0; line < DOOMGENERIC_RESY; line++) {
-		memcpy(
-			(void *)((uintptr_t)(fbPtr) + (fbStride * line) + fbOffsetY + fbOffsetX),
-				(void *)(((uintptr_t)DG_ScreenBuffer) + (DOOMGENERIC_RESX * line * fbBytesPerPixel)),
-			 (fbBytesPerPixel * DOOMGENERIC_RESX)
-		);
+	// the frame is already in the framebuffer
+	if (fbVsync) {
+		__u32 crtc = 0;
+		ioctl(fbFd, FBIO_WAITFORVSYNC, &crtc);
+	}
+
+	if (fbPageFlip) {
+		// show the page just drawn, and draw the next into the other
+		fbInfo.xoffset = 0;
+		fbInfo.yoffset = fbPage * fbHeight;
+		ioctl(fbFd, FBIOPAN_DISPLAY, &fbInfo);
+
+		fbPage ^= 1;
+		DG_ScreenBuffer = pagePtr(fbPage);
 	}
 
 	checkKeys();
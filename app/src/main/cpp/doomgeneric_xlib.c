@@ -1,23 +1,38 @@
 #include "doomkeys.h"
+#include "m_argv.h"
 
 #include "doomgeneric.h"
 
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
 #include <X11/XKBlib.h>
+#include <X11/extensions/XShm.h>
 
 static Display *s_Display = NULL;
 static Window s_Window = 0;
 static int s_Screen = 0;
 static GC s_Gc = 0;
 static XImage *s_Image = NULL;
+static int s_Width = DOOMGENERIC_RESX;
+static int s_Height = DOOMGENERIC_RESY;
+
+// With MIT-SHM the image is in memory shared with the X server, and
+// DG_ScreenBuffer points into it, so I_FinishUpdate draws the frame
+// where the server reads it from.
+static XShmSegmentInfo s_ShmInfo;
+static int s_UseShm = 0;
+static int s_ShmCompletion = 0;
+static int s_ShmFailed = 0;
 
 #define KEYQUEUE_SIZE 16
 
@@ -77,6 +92,111 @@ static void addKeyToQueue(int pressed, unsigned int keyCode)
 	s_KeyQueueWriteIndex %= KEYQUEUE_SIZE;
 }
 
+static int shmErrorHandler(Display *display, XErrorEvent *error)
+{
+    (void) display;
+    (void) error;
+
+    s_ShmFailed = 1;
+
+    return 0;
+}
+
+// Create a shared memory image, or return NULL if the server can't
+// (the display may be remote).
+static XImage *createShmImage(Visual *visual, int depth)
+{
+    XImage *image;
+    XErrorHandler oldHandler;
+
+    if (!XShmQueryExtension(s_Display))
+    {
+        return NULL;
+    }
+
+    image = XShmCreateImage(s_Display, visual, depth, ZPixmap, NULL, &s_ShmInfo, s_Width, s_Height);
+
+    if (image == NULL)
+    {
+        return NULL;
+    }
+
+    s_ShmInfo.shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height, IPC_CREAT | 0600);
+
+    if (s_ShmInfo.shmid < 0)
+    {
+        XDestroyImage(image);
+        return NULL;
+    }
+
+    s_ShmInfo.shmaddr = image->data = shmat(s_ShmInfo.shmid, NULL, 0);
+    s_ShmInfo.readOnly = False;
+
+    // Attaching fails asynchronously, so catch the error here.
+
+    s_ShmFailed = 0;
+    oldHandler = XSetErrorHandler(shmErrorHandler);
+
+    if (s_ShmInfo.shmaddr != (char *) -1)
+    {
+        XShmAttach(s_Display, &s_ShmInfo);
+    }
+    else
+    {
+        s_ShmFailed = 1;
+    }
+
+    XSync(s_Display, False);
+    XSetErrorHandler(oldHandler);
+
+    // Gone once both sides have let go of it
+    shmctl(s_ShmInfo.shmid, IPC_RMID, NULL);
+
+    if (s_ShmFailed)
+    {
+        if (s_ShmInfo.shmaddr != (char *) -1)
+        {
+            shmdt(s_ShmInfo.shmaddr);
+        }
+
+        image->data = NULL;
+        XDestroyImage(image);
+        return NULL;
+    }
+
+    s_ShmCompletion = XShmGetEventBase(s_Display) + ShmCompletion;
+
+    return image;
+}
+
+static unsigned int maskOffset(unsigned long mask)
+{
+    unsigned int offset = 0;
+
+    while (mask != 0 && !(mask & 1))
+    {
+        mask >>= 1;
+        offset++;
+    }
+
+    return offset;
+}
+
+static unsigned int maskLength(unsigned long mask)
+{
+    unsigned int length = 0;
+
+    mask >>= maskOffset(mask);
+
+    while (mask & 1)
+    {
+        mask >>= 1;
+        length++;
+    }
+
+    return length;
+}
+
 void DG_Init()
 {
 	memset(s_KeyQueue, 0, KEYQUEUE_SIZE * sizeof(unsigned short));
@@ -96,8 +216,29 @@ void DG_Init()
     attr.background_pixel = BlackPixel(s_Display, s_Screen);
 
     int depth = DefaultDepth(s_Display, s_Screen);
+    Visual *visual = DefaultVisual(s_Display, s_Screen);
+
+    //!
+    // @arg <n>
+    // @platform xlib
+    //
+    // Scale the window up by a whole number, as the frame is converted.
+    //
 
-    s_Window = XCreateSimpleWindow(s_Display, DefaultRootWindow(s_Display), 0, 0, DOOMGENERIC_RESX, DOOMGENERIC_RESY, 0, blackColor, blackColor);
+    int p = M_CheckParmWithArgs("-scale", 1);
+
+    if (p > 0)
+    {
+        int scale = atoi(myargv[p + 1]);
+
+        if (scale >= 1 && scale <= 8)
+        {
+            s_Width = DOOMGENERIC_RESX * scale;
+            s_Height = DOOMGENERIC_RESY * scale;
+        }
+    }
+
+    s_Window = XCreateSimpleWindow(s_Display, DefaultRootWindow(s_Display), 0, 0, s_Width, s_Height, 0, blackColor, blackColor);
 
     XSelectInput(s_Display, s_Window, StructureNotifyMask | KeyPressMask | KeyReleaseMask);
 
@@ -121,7 +262,60 @@ void DG_Init()
         }
     }
 
-    s_Image = XCreateImage(s_Display, DefaultVisual(s_Display, s_Screen), depth, ZPixmap, 0, (char *)DG_ScreenBuffer, DOOMGENERIC_RESX, DOOMGENERIC_RESX, 32, 0);
+    //!
+    // @platform xlib
+    //
+    // Don't use the MIT-SHM extension; send frames with XPutImage.
+    //
+
+    if (!M_ParmExists("-noshm"))
+    {
+        s_Image = createShmImage(visual, depth);
+    }
+
+    s_UseShm = s_Image != NULL;
+
+    if (s_Image == NULL)
+    {
+        s_Image = XCreateImage(s_Display, visual, depth, ZPixmap, 0, NULL, s_Width, s_Height, 32, 0);
+        s_Image->data = malloc(s_Image->bytes_per_line * s_Image->height);
+    }
+
+    printf("DG_Init: %dx%d, %s\n", s_Width, s_Height, s_UseShm ? "MIT-SHM" : "XPutImage");
+
+    // I_FinishUpdate converts the frame straight into the image.
+
+    free(DG_ScreenBuffer);
+    DG_ScreenBuffer = (pixel_t *) s_Image->data;
+
+    memset(&DG_ScreenInfo, 0, sizeof(DG_ScreenInfo));
+    DG_ScreenInfo.xres = s_Width;
+    DG_ScreenInfo.yres = s_Height;
+    DG_ScreenInfo.bits_per_pixel = s_Image->bits_per_pixel;
+    DG_ScreenInfo.line_length = s_Image->bytes_per_line;
+    DG_ScreenInfo.red.offset = maskOffset(s_Image->red_mask);
+    DG_ScreenInfo.red.length = maskLength(s_Image->red_mask);
+    DG_ScreenInfo.green.offset = maskOffset(s_Image->green_mask);
+    DG_ScreenInfo.green.length = maskLength(s_Image->green_mask);
+    DG_ScreenInfo.blue.offset = maskOffset(s_Image->blue_mask);
+    DG_ScreenInfo.blue.length = maskLength(s_Image->blue_mask);
+}
+
+static void handleEvent(XEvent *e)
+{
+    if (e->type == KeyPress)
+    {
+        KeySym sym = XkbKeycodeToKeysym(s_Display, e->xkey.keycode, 0, 0);
+        //printf("KeyPress:%d sym:%d\n", e->xkey.keycode, sym);
+
+        addKeyToQueue(1, sym);
+    }
+    else if (e->type == KeyRelease)
+    {
+        KeySym sym = XkbKeycodeToKeysym(s_Display, e->xkey.keycode, 0, 0);
+        //printf("KeyRelease:%d sym:%d\n", e->xkey.keycode, sym);
+        addKeyToQueue(0, sym);
+    }
 }
 
 
@@ -133,22 +327,33 @@ void DG_DrawFrame()
         {
             XEvent e;
             XNextEvent(s_Display, &e);
-            if (e.type == KeyPress)
-            {
-                KeySym sym = XkbKeycodeToKeysym(s_Display, e.xkey.keycode, 0, 0);
-                //printf("KeyPress:%d sym:%d\n", e.xkey.keycode, sym);
+            handleEvent(&e);
+        }
 
-                addKeyToQueue(1, sym);
-            }
-            else if (e.type == KeyRelease)
+        if (s_UseShm)
+        {
+            // The next frame is drawn into the same memory, so wait
+            // for the server to be done with this one.
+
+            XShmPutImage(s_Display, s_Window, s_Gc, s_Image, 0, 0, 0, 0, s_Width, s_Height, True);
+
+            while (1)
             {
-                KeySym sym = XkbKeycodeToKeysym(s_Display, e.xkey.keycode, 0, 0);
-                //printf("KeyRelease:%d sym:%d\n", e.xkey.keycode, sym);
-                addKeyToQueue(0, sym);
+                XEvent e;
+                XNextEvent(s_Display, &e);
+
+                if (e.type == s_ShmCompletion)
+                {
+                    break;
+                }
+
+                handleEvent(&e);
             }
         }
-
-        XPutImage(s_Display, s_Window, s_Gc, s_Image, 0, 0, 0, 0, DOOMGENERIC_RESX, DOOMGENERIC_RESY);
+        else
+        {
+            XPutImage(s_Display, s_Window, s_Gc, s_Image, 0, 0, 0, 0, s_Width, s_Height);
+        }
 
         //XFlush(s_Display);
     }
@@ -17,6 +17,7 @@
 
 
 
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <math.h>
@@ -40,6 +41,7 @@
 #include "i_video.h"
 
 #include "p_setup.h"
+#include "p_hash.h"
 #include "p_saveg.h"
 #include "p_tick.h"
 
@@ -74,8 +76,11 @@
 
 
 #define SAVEGAMESIZE	0x2c000
+#define DEMOSEEKSTEP	(10*TICRATE)
 
 void	G_ReadDemoTiccmd (ticcmd_t* cmd); 
+void	G_CheckDemoSnapshot (void);
+void	G_DoSeekDemo (void);
 void	G_WriteDemoTiccmd (ticcmd_t* cmd); 
 void	G_PlayerReborn (int player); 
  
@@ -88,6 +93,7 @@ void	G_DoCompleted (void);
 void	G_DoVictory (void); 
 void	G_DoWorldDone (void); 
 void	G_DoSaveGame (void); 
+static void G_CheckSaveGame (void);
  
 // Gamestate the last time G_Ticker was called.
 
@@ -135,7 +141,9 @@ boolean         demoplayback;
 boolean		netdemo; 
 byte*		demobuffer;
 byte*		demo_p;
+int		demotic;			// tics read from the demo
 byte*		demoend; 
+static boolean	demoseeking;		// G_DoSeekDemo running up to a tic
 boolean         singledemo;            	// quit after playing a demo from cmdline 
  
 boolean         precache = true;        // if true, load all graphics at start 
@@ -222,8 +230,6 @@ static boolean *joybuttons = &joyarray[1];		// allow [-1]
 static int      savegameslot; 
 static char     savedescription[32]; 
  
-#define	BODYQUESIZE	32
-
 mobj_t*		bodyque[BODYQUESIZE]; 
 int		bodyqueslot; 
  
@@ -746,6 +752,17 @@ boolean G_Responder (event_t* ev)
 	return true; 
     }
     
+    // seek through a demo played on its own
+    if (singledemo && demoplayback && ev->type == ev_keydown
+     && (ev->data1 == KEY_LEFTARROW || ev->data1 == KEY_RIGHTARROW))
+    {
+	if (ev->data1 == KEY_LEFTARROW)
+	    G_SeekDemo (demotic - DEMOSEEKSTEP);
+	else
+	    G_SeekDemo (demotic + DEMOSEEKSTEP);
+	return true;
+    }
+
     // any other key pops up menu if in demos
     if (gameaction == ga_nothing && !singledemo && 
 	(demoplayback || gamestate == GS_DEMOSCREEN) 
@@ -857,6 +874,9 @@ void G_Ticker (void)
     int		buf; 
     ticcmd_t*	cmd;
     
+    // report a savegame that could not be written
+    G_CheckSaveGame ();
+
     // do player reborns if needed
     for (i=0 ; i<MAXPLAYERS ; i++) 
 	if (playeringame[i] && players[i].playerstate == PST_REBORN) 
@@ -896,11 +916,23 @@ void G_Ticker (void)
             players[consoleplayer].message = DEH_String("screen shot");
 	    gameaction = ga_nothing; 
 	    break; 
+	  case ga_seekdemo: 
+	    // The seek has run the tics up to the one wanted, so
+	    // running this one as well would land a tic past it.
+	    G_DoSeekDemo (); 
+	    return; 
 	  case ga_nothing: 
 	    break; 
 	} 
     }
     
+    // sample zone fragmentation once a second
+    if (gametic % TICRATE == 0)
+        Z_TelemetrySample ();
+
+    if (demoplayback)
+        G_CheckDemoSnapshot ();
+
     // get commands, check consistancy,
     // and build new consistancy check
     buf = (gametic/ticdup)%BACKUPTICS; 
@@ -958,6 +990,9 @@ void G_Ticker (void)
 	    } 
 	}
     }
+
+    if (demoplayback)
+        ++demotic;
     
     // check for special buttons
     for (i=0 ; i<MAXPLAYERS ; i++)
@@ -1006,6 +1041,8 @@ void G_Ticker (void)
     { 
       case GS_LEVEL: 
 	P_Ticker (); 
+	if (!demoseeking)
+	    P_WriteStateHash (gametic);
 	ST_Ticker (); 
 	AM_Ticker (); 
 	HU_Ticker ();            
@@ -1536,6 +1573,12 @@ void R_ExecuteSetViewSize (void);
 
 char	savename[256];
 
+// loading the suspended game at startup
+static boolean resuming;
+
+// paused by G_SuspendGame
+static boolean suspendpaused;
+
 void G_LoadGame (char* name) 
 { 
     M_StringCopy(savename, name, sizeof(savename));
@@ -1547,25 +1590,53 @@ void G_LoadGame (char* name)
 
 void G_DoLoadGame (void) 
 {
+    FILE *handle;
+    byte *savebuffer;
+    long length;
     int savedleveltime;
+    boolean wasresuming;
 	 
     gameaction = ga_nothing; 
+
+    // the file may still be being written
+    G_FinishSaveGame ();
 	 
-    save_stream = fopen(savename, "rb");
+    // read the whole savegame into memory and parse it from there
+    handle = fopen(savename, "rb");
 
-    if (save_stream == NULL)
+    if (handle == NULL)
     {
     	return;
     }
 
+    length = M_FileLength(handle);
+    savebuffer = Z_Malloc(length, PU_STATIC, NULL);
+    length = fread(savebuffer, 1, length, handle);
+    fclose(handle);
+
+    save_stream = mem_fopen_read(savebuffer, length);
     savegame_error = false;
 
     if (!P_ReadSaveGameHeader())
     {
-        fclose(save_stream);
+        mem_fclose(save_stream);
+        Z_Free(savebuffer);
+
+        // a suspended game that can't be loaded (say, from an older
+        // version) is forgotten and we go to the title screen instead
+        if (resuming)
+        {
+            resuming = false;
+            remove(savename);
+            D_StartTitle();
+        }
+
         return;
     }
 
+    wasresuming = resuming;
+    resuming = false;
+
     savedleveltime = leveltime;
     
     // load a base level 
@@ -1582,7 +1653,13 @@ void G_DoLoadGame (void)
     if (!P_ReadSaveGameEOF())
 	I_Error ("Bad savegame");
 
-    fclose(save_stream);
+    mem_fclose(save_stream);
+    Z_Free(savebuffer);
+
+    // The suspended game is running again; if we are killed without
+    // being suspended first, a stale copy must not come back.
+    if (wasresuming)
+        remove(savename);
     
     if (setsizeneeded)
     	R_ExecuteSetViewSize ();
@@ -1607,38 +1684,164 @@ G_SaveGame
     sendsave = true;
 }
 
-void G_DoSaveGame (void) 
-{ 
-    char *savegame_file;
-    char *temp_savegame_file;
-    char *recovery_savegame_file;
 
-    recovery_savegame_file = NULL;
-    temp_savegame_file = P_TempSaveGameFile();
-    savegame_file = P_SaveGameFile(savegameslot);
+//
+// Savegames are serialized into memory on the game thread and
+// written out by a background thread, so saving costs a tic no
+// more than copying the game state does.
+//
+static i_thread_t *savegame_thread;
+static MEMFILE *savegame_buffer;
+static char savegame_target[256];
+static char *savegame_temp;
+static char *savegame_recovery;
+static boolean savegame_written;
+static boolean savegame_recovered;
+static volatile boolean savegame_done;
+
+static void G_WriteSaveGameFile(void *unused)
+{
+    void *buf;
+    size_t buflen;
+
+    (void) unused;
+
+    mem_get_buf(savegame_buffer, &buf, &buflen);
 
-    // Open the savegame file for writing.  We write to a temporary file
-    // and then rename it at the end if it was successfully written.
-    // This prevents an existing savegame from being overwritten by 
-    // a corrupted one, or if a savegame buffer overrun occurs.
-    save_stream = fopen(temp_savegame_file, "wb");
+    // We write to a temporary file and then rename it at the end if
+    // it was successfully written.  This prevents an existing savegame
+    // from being overwritten by a corrupted one.
 
-    if (save_stream == NULL)
+    savegame_written = M_WriteFile(savegame_temp, buf, buflen);
+
+    if (savegame_written)
+    {
+        // Now rename the temporary savegame file to the actual savegame
+        // file, overwriting the old savegame if there was one there.
+
+        remove(savegame_target);
+        rename(savegame_temp, savegame_target);
+    }
+    else
     {
         // Failed to save the game, so we're going to have to abort. But
-        // to be nice, save to somewhere else before we call I_Error().
-        recovery_savegame_file = M_TempFile("recovery.dsg");
-        save_stream = fopen(recovery_savegame_file, "wb");
-        if (save_stream == NULL)
-        {
-            I_Error("Failed to open either '%s' or '%s' to write savegame.",
-                    temp_savegame_file, recovery_savegame_file);
-        }
+        // to be nice, save to somewhere else first.
+
+        savegame_recovered = M_WriteFile(savegame_recovery, buf, buflen);
+    }
+
+    savegame_done = true;
+}
+
+//
+// Describe why the last savegame was not written, and where it
+// went instead, if anywhere.
+//
+static void G_SaveGameFailure(char *message, size_t message_len)
+{
+    if (savegame_recovered)
+    {
+        // We failed to save to the normal location, but we wrote a
+        // recovery file to the temp directory.
+        M_snprintf(message, message_len,
+                   "Failed to open savegame file '%s' for writing.\n"
+                   "But your game has been saved to '%s' for recovery.",
+                   savegame_temp, savegame_recovery);
+    }
+    else
+    {
+        M_snprintf(message, message_len,
+                   "Failed to open either '%s' or '%s' to write savegame.",
+                   savegame_temp, savegame_recovery);
+    }
+}
+
+//
+// G_FinishSaveGame
+// Waits for the savegame being written, if there is one.
+//
+void G_FinishSaveGame(void)
+{
+    if (savegame_thread == NULL)
+    {
+        return;
+    }
+
+    I_WaitThread(savegame_thread);
+    savegame_thread = NULL;
+    mem_fclose(savegame_buffer);
+
+    if (!savegame_written)
+    {
+        char message[512];
+
+        // Now we can bomb out with an error.
+        G_SaveGameFailure(message, sizeof(message));
+        I_Error("%s", message);
+    }
+}
+
+//
+// G_CheckSaveGame
+// Called every tic, so that a savegame that could not be written is
+// reported as soon as the writer is done, not at the next save.
+//
+static void G_CheckSaveGame(void)
+{
+    if (savegame_thread != NULL && savegame_done)
+    {
+        G_FinishSaveGame();
+    }
+}
+
+//
+// At exit, the savegame being written is waited for. I_Error cannot
+// be called from here, so a failure is only printed.
+//
+static void G_FlushSaveGame(void)
+{
+    char message[512];
+
+    if (savegame_thread == NULL)
+    {
+        return;
+    }
+
+    I_WaitThread(savegame_thread);
+    savegame_thread = NULL;
+
+    if (!savegame_written)
+    {
+        G_SaveGameFailure(message, sizeof(message));
+        fprintf(stderr, "%s\n", message);
+    }
+}
+
+//
+// G_StartSaveGame
+// Snapshots the game into memory and starts writing it to a file.
+// vanillalimit is false for the snapshot taken when the app is sent
+// away, which must not fail however busy the level is.
+//
+static void G_StartSaveGame(char *filename, char *description,
+                            boolean vanillalimit)
+{
+    // only one savegame is written at a time
+    G_FinishSaveGame();
+
+    if (savegame_recovery == NULL)
+    {
+        savegame_recovery = M_TempFile("recovery.dsg");
+        I_AtExit(G_FlushSaveGame, true);
     }
 
+    savegame_temp = P_TempSaveGameFile();
+    M_StringCopy(savegame_target, filename, sizeof(savegame_target));
+
+    save_stream = mem_fopen_write();
     savegame_error = false;
 
-    P_WriteSaveGameHeader(savedescription);
+    P_WriteSaveGameHeader(description);
  
     P_ArchivePlayers (); 
     P_ArchiveWorld (); 
@@ -1650,30 +1853,23 @@ void G_DoSaveGame (void)
     // Enforce the same savegame size limit as in Vanilla Doom, 
     // except if the vanilla_savegame_limit setting is turned off.
 
-    if (vanilla_savegame_limit && ftell(save_stream) > SAVEGAMESIZE)
+    if (vanillalimit && vanilla_savegame_limit
+     && mem_ftell(save_stream) > SAVEGAMESIZE)
     {
         I_Error ("Savegame buffer overrun");
     }
     
-    // Finish up, close the savegame file.
-
-    fclose(save_stream);
-
-    if (recovery_savegame_file != NULL)
-    {
-        // We failed to save to the normal location, but we wrote a
-        // recovery file to the temp directory. Now we can bomb out
-        // with an error.
-        I_Error("Failed to open savegame file '%s' for writing.\n"
-                "But your game has been saved to '%s' for recovery.",
-                temp_savegame_file, recovery_savegame_file);
-    }
+    // Hand the buffer to the writer thread.
 
-    // Now rename the temporary savegame file to the actual savegame
-    // file, overwriting the old savegame if there was one there.
+    savegame_buffer = save_stream;
+    save_stream = NULL;
+    savegame_done = false;
+    savegame_thread = I_StartThread(G_WriteSaveGameFile, NULL);
+}
 
-    remove(savegame_file);
-    rename(temp_savegame_file, savegame_file);
+void G_DoSaveGame (void) 
+{ 
+    G_StartSaveGame(P_SaveGameFile(savegameslot), savedescription, true);
     
     gameaction = ga_nothing;
     M_StringCopy(savedescription, "", sizeof(savedescription));
@@ -1685,6 +1881,80 @@ void G_DoSaveGame (void)
 } 
  
 
+//
+// G_SuspendGame
+// Called when the app loses its window and may not get it back.
+// The game is paused and a snapshot of it written out, to be
+// picked up by G_LoadSuspendedGame the next time the app starts
+// if the process is killed in the meantime.
+//
+void G_SuspendGame (void)
+{
+    if (!usergame || gamestate != GS_LEVEL || netgame || demorecording)
+    {
+        // nothing to come back to
+        G_ClearSuspendedGame();
+        return;
+    }
+
+    if (!paused)
+    {
+        paused = true;
+        suspendpaused = true;
+        S_PauseSound();
+    }
+
+    G_StartSaveGame(P_SuspendGameFile(), "SUSPENDED", false);
+}
+
+//
+// G_ResumeGame
+// The window is back while we are still running.
+//
+void G_ResumeGame (void)
+{
+    if (suspendpaused)
+    {
+        paused = false;
+        suspendpaused = false;
+        S_ResumeSound();
+    }
+}
+
+//
+// G_LoadSuspendedGame
+// At startup, load the game suspended by a previous run, if there
+// is one, instead of going to the title screen.
+//
+boolean G_LoadSuspendedGame (void)
+{
+    static boolean registered = false;
+
+    if (!registered)
+    {
+        // quitting from the menu means the player is done
+        I_AtExit(G_ClearSuspendedGame, false);
+        registered = true;
+    }
+
+    if (!M_FileExists(P_SuspendGameFile()))
+    {
+        return false;
+    }
+
+    G_LoadGame(P_SuspendGameFile());
+    resuming = true;
+
+    return true;
+}
+
+void G_ClearSuspendedGame (void)
+{
+    G_FinishSaveGame();
+    remove(P_SuspendGameFile());
+}
+ 
+
 //
 // G_InitNew
 // Can be called by the startup code or the menu task,
@@ -1921,36 +2191,90 @@ void G_ReadDemoTiccmd (ticcmd_t* cmd)
     cmd->buttons = (unsigned char)*demo_p++; 
 } 
 
-// Increase the size of the demo buffer to allow unlimited demos
+//
+// Demos being recorded are streamed to disk: ticcmds go into one half
+// of a small double buffer while a background thread appends the other
+// half to the file.  Every flush leaves a DEMOMARKER at the end of the
+// file, so what is on disk is a valid demo even if we never get to
+// G_CheckDemoStatus.
+//
+#define DEMOBUFFERSIZE		0x2000		// bytes in each half
+#define DEMOFLUSHTICS		(5*TICRATE)	// flush at least this often
+
+static byte		demohalves[2][DEMOBUFFERSIZE];
+static int		demohalf;
+static FILE*		demofile;
+static i_thread_t*	demo_thread;
+static byte*		demoflush_buf;
+static size_t		demoflush_len;
+static boolean		demoflush_failed;
+static int		demoflushtic;
+static size_t		demolength;		// bytes handed to the writer
+static size_t		demomaxsize;		// vanilla demo limit
+
+static void G_WriteDemoChunk (void *unused)
+{
+    (void) unused;
+
+    // Append the chunk and a marker, then step back over the marker
+    // so the next chunk overwrites it.
+
+    if (fwrite (demoflush_buf, 1, demoflush_len, demofile) != demoflush_len
+     || fputc (DEMOMARKER, demofile) == EOF
+     || fflush (demofile) != 0
+     || fseek (demofile, -1, SEEK_CUR) != 0)
+    {
+	demoflush_failed = true;
+    }
+}
+
+static void G_WaitDemoWriter (void)
+{
+    if (demo_thread != NULL)
+    {
+	I_WaitThread (demo_thread);
+	demo_thread = NULL;
+    }
+}
 
-static void IncreaseDemoBuffer(void)
+//
+// G_FlushDemo
+// Hands the filled half of the buffer to the writer and
+// carries on recording into the other half.
+//
+static void G_FlushDemo (void)
 {
-    int current_length;
-    byte *new_demobuffer;
-    byte *new_demop;
-    int new_length;
+    G_WaitDemoWriter ();
 
-    // Find the current size
+    demoflush_buf = demobuffer;
+    demoflush_len = demo_p - demobuffer;
+    demolength += demoflush_len;
+    demoflushtic = gametic;
 
-    current_length = demoend - demobuffer;
-    
-    // Generate a new buffer twice the size
-    new_length = current_length * 2;
-    
-    new_demobuffer = Z_Malloc(new_length, PU_STATIC, 0);
-    new_demop = new_demobuffer + (demo_p - demobuffer);
+    demo_thread = I_StartThread (G_WriteDemoChunk, NULL);
 
-    // Copy over the old data
+    demohalf ^= 1;
+    demobuffer = demo_p = demohalves[demohalf];
+    demoend = demobuffer + DEMOBUFFERSIZE;
+}
 
-    memcpy(new_demobuffer, demobuffer, current_length);
+//
+// G_CloseDemo
+// Writes out whatever is left and closes the demo file.
+// Also run at exit, so an aborted recording keeps every tic.
+//
+static void G_CloseDemo (void)
+{
+    if (demofile == NULL)
+	return;
 
-    // Free the old buffer and point the demo pointers at the new buffer.
+    G_FlushDemo ();
+    G_WaitDemoWriter ();
 
-    Z_Free(demobuffer);
+    if (fclose (demofile) != 0)
+	demoflush_failed = true;
 
-    demobuffer = new_demobuffer;
-    demo_p = new_demop;
-    demoend = demobuffer + new_length;
+    demofile = NULL;
 }
 
 void G_WriteDemoTiccmd (ticcmd_t* cmd) 
@@ -1960,6 +2284,22 @@ void G_WriteDemoTiccmd (ticcmd_t* cmd)
     if (gamekeydown[key_demo_quit])           // press q to end demo recording 
 	G_CheckDemoStatus (); 
 
+    if (vanilla_demo_limit
+     && demolength + (demo_p - demobuffer) + 16 > demomaxsize)
+    {
+        // no more space 
+        G_CheckDemoStatus (); 
+        return; 
+    }
+
+    if (demo_p > demoend - 16 || gametic - demoflushtic >= DEMOFLUSHTICS)
+    {
+        G_FlushDemo ();
+
+        if (demoflush_failed)
+            I_Error ("Failed to write demo %s", demoname);
+    }
+
     demo_start = demo_p;
 
     *demo_p++ = cmd->forwardmove; 
@@ -1982,23 +2322,6 @@ void G_WriteDemoTiccmd (ticcmd_t* cmd)
     // reset demo pointer back
     demo_p = demo_start;
 
-    if (demo_p > demoend - 16)
-    {
-        if (vanilla_demo_limit)
-        {
-            // no more space 
-            G_CheckDemoStatus (); 
-            return; 
-        }
-        else
-        {
-            // Vanilla demo limit disabled: unlimited
-            // demo lengths!
-
-            IncreaseDemoBuffer();
-        }
-    } 
-	
     G_ReadDemoTiccmd (cmd);         // make SURE it is exactly the same 
 } 
  
@@ -2030,8 +2353,19 @@ void G_RecordDemo (char *name)
     i = M_CheckParmWithArgs("-maxdemo", 1);
     if (i)
 	maxsize = atoi(myargv[i+1])*1024;
-    demobuffer = Z_Malloc (maxsize,PU_STATIC,NULL); 
-    demoend = demobuffer + maxsize;
+    demomaxsize = maxsize;
+
+    demofile = fopen (demoname, "wb");
+    if (demofile == NULL)
+	I_Error ("Couldn't open demo file %s", demoname);
+
+    I_AtExit (G_CloseDemo, true);
+
+    demohalf = 0;
+    demolength = 0;
+    demoflush_failed = false;
+    demobuffer = demo_p = demohalves[demohalf];
+    demoend = demobuffer + DEMOBUFFERSIZE;
 	
     demorecording = true; 
 } 
@@ -2095,6 +2429,9 @@ void G_BeginRecording (void)
 	 
     for (i=0 ; i<MAXPLAYERS ; i++) 
 	*demo_p++ = playeringame[i]; 		 
+
+    // get the header onto disk straight away
+    G_FlushDemo ();
 } 
  
 
@@ -2149,6 +2486,174 @@ static char *DemoVersionDescription(int version)
     }
 }
 
+//
+// DEMO SEEKING
+// While a demo given with -playdemo runs, the level is snapshotted
+// every so many tics. To go back, or far ahead, the nearest snapshot
+// before the wanted tic is restored and the tics from there run
+// without drawing. There are never more than DEMOSNAPSHOTS: when full,
+// every other one is dropped and the interval doubled.
+//
+#define DEMOSNAPSHOTS		64
+#define DEMOSNAPSHOTTICS	(10*TICRATE)
+
+typedef struct
+{
+    int		tic;		// demotic it was taken at
+    int		demopos;	// offset of the next ticcmd in the demo
+    byte*	data;
+    size_t	length;
+} demosnapshot_t;
+
+static demosnapshot_t	demosnapshots[DEMOSNAPSHOTS];
+static int		numdemosnapshots;
+static int		demosnapshottics = DEMOSNAPSHOTTICS;
+static int		demoseektic = -1;
+
+static void G_FreeDemoSnapshots (void)
+{
+    int		i;
+
+    for (i=0 ; i<numdemosnapshots ; i++)
+	free (demosnapshots[i].data);
+
+    numdemosnapshots = 0;
+    demosnapshottics = DEMOSNAPSHOTTICS;
+}
+
+//
+// G_CheckDemoSnapshot
+// Called at the start of each tic of demo playback.
+//
+void G_CheckDemoSnapshot (void)
+{
+    demosnapshot_t*	snapshot;
+    void*		buf;
+    size_t		buflen;
+    int			i;
+
+    if (!singledemo || gamestate != GS_LEVEL
+     || demotic % demosnapshottics != 0)
+	return;
+
+    // already have this one (we have been here before a rewind)
+    if (numdemosnapshots > 0
+     && demosnapshots[numdemosnapshots - 1].tic >= demotic)
+	return;
+
+    save_stream = mem_fopen_write ();
+    savegame_error = false;
+
+    P_WriteSaveGameHeader ("SNAPSHOT");
+    P_ArchiveSnapshot ();
+
+    mem_get_buf (save_stream, &buf, &buflen);
+
+    snapshot = &demosnapshots[numdemosnapshots];
+    snapshot->data = malloc (buflen);
+
+    if (snapshot->data != NULL)
+    {
+	memcpy (snapshot->data, buf, buflen);
+	snapshot->length = buflen;
+	snapshot->tic = demotic;
+	snapshot->demopos = demo_p - demobuffer;
+	++numdemosnapshots;
+    }
+
+    mem_fclose (save_stream);
+    save_stream = NULL;
+
+    if (numdemosnapshots == DEMOSNAPSHOTS)
+    {
+	for (i=0 ; i<DEMOSNAPSHOTS/2 ; i++)
+	{
+	    free (demosnapshots[2*i + 1].data);
+	    demosnapshots[i] = demosnapshots[2*i];
+	}
+
+	numdemosnapshots = DEMOSNAPSHOTS/2;
+	demosnapshottics *= 2;
+    }
+}
+
+static void G_RestoreDemoSnapshot (demosnapshot_t *snapshot)
+{
+    int savedleveltime;
+
+    save_stream = mem_fopen_read (snapshot->data, snapshot->length);
+    savegame_error = false;
+
+    P_ReadSaveGameHeader ();
+    savedleveltime = leveltime;
+
+    // load the level fresh, then replace its state
+    precache = false;
+    G_InitNew (gameskill, gameepisode, gamemap); 
+    precache = true;
+
+    leveltime = savedleveltime;
+    usergame = false;
+    demoplayback = true;
+
+    P_UnArchiveSnapshot ();
+
+    mem_fclose (save_stream);
+    save_stream = NULL;
+
+    demo_p = demobuffer + snapshot->demopos;
+    demotic = snapshot->tic;
+
+    // no screen wipe
+    wipegamestate = GS_LEVEL;
+}
+
+//
+// G_SeekDemo
+// Asks for the demo to continue from the given tic.
+//
+void G_SeekDemo (int tic)
+{
+    demoseektic = tic < 0 ? 0 : tic;
+
+    if (demoplayback && gameaction == ga_nothing)
+	gameaction = ga_seekdemo;
+}
+
+void G_DoSeekDemo (void)
+{
+    demosnapshot_t*	snapshot;
+    int			i;
+
+    gameaction = ga_nothing;
+    snapshot = NULL;
+
+    for (i=0 ; i<numdemosnapshots ; i++)
+    {
+	if (demosnapshots[i].tic <= demoseektic)
+	    snapshot = &demosnapshots[i];
+    }
+
+    if (snapshot != NULL
+     && (demoseektic < demotic || snapshot->tic > demotic))
+    {
+	G_RestoreDemoSnapshot (snapshot);
+    }
+
+    // run up to the tic, quietly
+    S_SetSfxVolume (0);
+    demoseeking = true;
+
+    while (demoplayback && demotic < demoseektic)
+	G_Ticker ();
+
+    demoseeking = false;
+    S_SetSfxVolume (sfxVolume * 8);
+
+    demoseektic = -1;
+}
+
+
 void G_DoPlayDemo (void) 
 { 
     skill_t skill; 
@@ -2212,8 +2717,15 @@ void G_DoPlayDemo (void)
 
     usergame = false; 
     demoplayback = true; 
+
+    G_FreeDemoSnapshots ();
+    demotic = 0;
+
+    if (demoseektic >= 0)
+        gameaction = ga_seekdemo;
 } 
 
+
 //
 // G_TimeDemo 
 //
@@ -2289,10 +2801,12 @@ boolean G_CheckDemoStatus (void)
  
     if (demorecording) 
     { 
-	*demo_p++ = DEMOMARKER; 
-	M_WriteFile (demoname, demobuffer, demo_p - demobuffer); 
-	Z_Free (demobuffer); 
+	G_CloseDemo (); 
 	demorecording = false; 
+
+	if (demoflush_failed)
+	    I_Error ("Failed to write demo %s", demoname);
+
 	I_Error ("Demo %s recorded",demoname); 
     } 
 	 
@@ -48,6 +48,18 @@ void G_DoLoadGame (void);
 // Called by M_Responder.
 void G_SaveGame (int slot, char* description);
 
+// Continue demo playback from the given tic.
+void G_SeekDemo (int tic);
+
+// Wait for a savegame still being written to disk.
+void G_FinishSaveGame (void);
+
+// Snapshot the game when the app is sent away, and pick it up again.
+void G_SuspendGame (void);
+void G_ResumeGame (void);
+boolean G_LoadSuspendedGame (void);
+void G_ClearSuspendedGame (void);
+
 // Only called by startup code.
 void G_RecordDemo (char* name);
 
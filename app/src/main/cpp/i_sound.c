@@ -143,7 +143,10 @@ void I_InitSound(boolean use_sfx_prefix)
 {
     // @vanilla
     // Disable all sound output.
-    boolean nosound = M_CheckParm("-nosound") > 0;
+    // Batch demo workers are forked, and sound threads do not
+    // survive that.
+    boolean nosound = M_CheckParm("-nosound") > 0
+                   || M_CheckParm("-batchdemo") > 0;
 
     // @vanilla
     // Disable sound effects.
@@ -22,6 +22,7 @@
 #include <string.h>
 
 #include <stdarg.h>
+#include <signal.h>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -30,6 +31,11 @@
 #include <unistd.h>
 #endif
 
+#if defined(__ANDROID__) || defined(__linux__) || defined(__FreeBSD__)
+#define HAVE_THREADS
+#include <pthread.h>
+#endif
+
 #ifdef ORIGCODE
 #include "SDL.h"
 #endif
@@ -57,6 +63,7 @@
 
 #define DEFAULT_RAM 6 /* MiB */
 #define MIN_RAM     6  /* MiB */
+#define DEFAULT_MAX_RAM 64 /* MiB */
 
 
 typedef struct atexit_listentry_s atexit_listentry_t;
@@ -82,6 +89,272 @@ void I_AtExit(atexit_func_t func, boolean run_on_error)
     exit_funcs = entry;
 }
 
+void I_ClearAtExit(void)
+{
+    exit_funcs = NULL;
+}
+
+struct i_thread_s
+{
+#ifdef HAVE_THREADS
+    pthread_t thread;
+#endif
+    thread_func_t func;
+    void *arg;
+};
+
+#ifdef HAVE_THREADS
+static void *ThreadMain(void *arg)
+{
+    i_thread_t *thread = arg;
+
+    thread->func(thread->arg);
+
+    return NULL;
+}
+#endif
+
+i_thread_t *I_StartThread(thread_func_t func, void *arg)
+{
+    i_thread_t *thread;
+
+    thread = malloc(sizeof(*thread));
+
+    if (thread == NULL)
+    {
+        I_Error("I_StartThread: out of memory");
+    }
+
+    thread->func = func;
+    thread->arg = arg;
+
+#ifdef HAVE_THREADS
+    if (pthread_create(&thread->thread, NULL, ThreadMain, thread) == 0)
+    {
+        return thread;
+    }
+#endif
+
+    // No thread; do the work now.
+
+    thread->func = NULL;
+    func(arg);
+
+    return thread;
+}
+
+void I_WaitThread(i_thread_t *thread)
+{
+#ifdef HAVE_THREADS
+    if (thread->func != NULL)
+    {
+        pthread_join(thread->thread, NULL);
+    }
+#endif
+
+    free(thread);
+}
+
+struct i_mutex_s
+{
+#ifdef HAVE_THREADS
+    pthread_mutex_t mutex;
+#endif
+    int unused;
+};
+
+i_mutex_t *I_CreateMutex(void)
+{
+    i_mutex_t *mutex;
+#ifdef HAVE_THREADS
+    pthread_mutexattr_t attr;
+#endif
+
+    mutex = malloc(sizeof(*mutex));
+
+    if (mutex == NULL)
+    {
+        I_Error("I_CreateMutex: out of memory");
+    }
+
+#ifdef HAVE_THREADS
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mutex->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+
+    return mutex;
+}
+
+void I_LockMutex(i_mutex_t *mutex)
+{
+#ifdef HAVE_THREADS
+    pthread_mutex_lock(&mutex->mutex);
+#endif
+}
+
+void I_UnlockMutex(i_mutex_t *mutex)
+{
+#ifdef HAVE_THREADS
+    pthread_mutex_unlock(&mutex->mutex);
+#endif
+}
+
+typedef struct
+{
+    i_pool_t *pool;
+    int slice;
+} poolworker_t;
+
+struct i_pool_s
+{
+#ifdef HAVE_THREADS
+    pthread_mutex_t mutex;
+    pthread_cond_t work;        // a new job was handed out
+    pthread_cond_t done;        // the last worker finished its slice
+    int generation;             // counts jobs handed out
+    int pending;                // workers yet to finish this job
+#endif
+    int numthreads;
+    thread_func_t func;
+    void **args;
+    int count;
+};
+
+#ifdef HAVE_THREADS
+static void *PoolThreadMain(void *arg)
+{
+    poolworker_t *worker = arg;
+    i_pool_t *pool = worker->pool;
+    int generation = 0;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+
+        while (pool->generation == generation)
+        {
+            pthread_cond_wait(&pool->work, &pool->mutex);
+        }
+
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (worker->slice < pool->count)
+        {
+            pool->func(pool->args[worker->slice]);
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+
+        if (--pool->pending == 0)
+        {
+            pthread_cond_signal(&pool->done);
+        }
+
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return NULL;
+}
+#endif
+
+i_pool_t *I_CreatePool(int threads)
+{
+    i_pool_t *pool;
+#ifdef HAVE_THREADS
+    poolworker_t *worker;
+    pthread_t thread;
+    int i;
+#endif
+
+    pool = malloc(sizeof(*pool));
+
+    if (pool == NULL)
+    {
+        I_Error("I_CreatePool: out of memory");
+    }
+
+    memset(pool, 0, sizeof(*pool));
+
+#ifdef HAVE_THREADS
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    // The threads live as long as the program does. Any that cannot
+    // be started leave their slices to the calling thread.
+
+    for (i = 0; i < threads; ++i)
+    {
+        worker = malloc(sizeof(*worker));
+
+        if (worker == NULL)
+        {
+            I_Error("I_CreatePool: out of memory");
+        }
+
+        worker->pool = pool;
+        worker->slice = i + 1;
+
+        if (pthread_create(&thread, NULL, PoolThreadMain, worker) != 0)
+        {
+            free(worker);
+            break;
+        }
+
+        pthread_detach(thread);
+        ++pool->numthreads;
+    }
+#endif
+
+    return pool;
+}
+
+void I_RunPool(i_pool_t *pool, thread_func_t func, void **args, int count)
+{
+    int i;
+
+#ifdef HAVE_THREADS
+    if (pool->numthreads > 0)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        pool->func = func;
+        pool->args = args;
+        pool->count = count;
+        pool->pending = pool->numthreads;
+        ++pool->generation;
+        pthread_cond_broadcast(&pool->work);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+#endif
+
+    if (count > 0)
+    {
+        func(args[0]);
+    }
+
+    for (i = pool->numthreads + 1; i < count; ++i)
+    {
+        func(args[i]);
+    }
+
+#ifdef HAVE_THREADS
+    if (pool->numthreads > 0)
+    {
+        pthread_mutex_lock(&pool->mutex);
+
+        while (pool->pending > 0)
+        {
+            pthread_cond_wait(&pool->done, &pool->mutex);
+        }
+
+        pthread_mutex_unlock(&pool->mutex);
+    }
+#endif
+}
+
 // Tactile feedback function, probably used for the Logitech Cyberman
 
 void I_Tactile(int on, int off, int total)
@@ -130,6 +403,15 @@ static byte *AutoAllocMemory(int *size, int default_ram, int min_ram)
     return zonemem;
 }
 
+#if defined(SIGUSR1) && !defined(__ANDROID__)
+static void I_TrimSignal(int sig)
+{
+    (void) sig;
+
+    Z_RequestTrim(Z_TRIM_PURGE);
+}
+#endif
+
 byte *I_ZoneBase (int *size)
 {
     byte *zonemem;
@@ -160,9 +442,50 @@ byte *I_ZoneBase (int *size)
     printf("zone memory: %p, %x allocated for zone\n", 
            zonemem, *size);
 
+#if defined(SIGUSR1) && !defined(__ANDROID__)
+    // Stand-in for the Android low memory callback, so that trimming
+    // can be exercised on other systems: kill -USR1 <pid>
+    signal(SIGUSR1, I_TrimSignal);
+#endif
+
     return zonemem;
 }
 
+//
+// The most memory the zone may grow to by adding chunks.
+//
+
+int I_ZoneMaxSize(void)
+{
+    int max_ram;
+    int p;
+
+    //!
+    // @arg <mb>
+    //
+    // Let the heap grow to at most this size, in MiB, when even
+    // purging the cache cannot make room (default 64). Use the -mb
+    // value for a fixed heap.
+    //
+
+    p = M_CheckParmWithArgs("-mbmax", 1);
+
+    if (p > 0)
+    {
+        max_ram = atoi(myargv[p+1]);
+    }
+    else if (M_CheckParmWithArgs("-mb", 1) > 0)
+    {
+        max_ram = 0;
+    }
+    else
+    {
+        max_ram = DEFAULT_MAX_RAM;
+    }
+
+    return max_ram * 1024 * 1024;
+}
+
 void I_PrintBanner(char *msg)
 {
     int i;
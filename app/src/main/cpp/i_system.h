@@ -34,6 +34,9 @@ void I_Init (void);
 // for the zone management.
 byte*	I_ZoneBase (int *size);
 
+// Limit for the zone to grow to when the base is full.
+int	I_ZoneMaxSize (void);
+
 boolean I_ConsoleStdout(void);
 
 
@@ -64,6 +67,42 @@ boolean I_GetMemoryValue(unsigned int offset, void *value, int size);
 
 void I_AtExit(atexit_func_t func, boolean run_if_error);
 
+// Forget the exit functions, in a forked process that must leave
+// what its parent set up for the parent to shut down.
+
+void I_ClearAtExit(void);
+
+// Run a function on a background thread. Where threads are not
+// available the function runs to completion before I_StartThread
+// returns. I_WaitThread waits for it to finish and frees the handle.
+
+typedef struct i_thread_s i_thread_t;
+typedef void (*thread_func_t)(void *arg);
+
+i_thread_t *I_StartThread(thread_func_t func, void *arg);
+void I_WaitThread(i_thread_t *thread);
+
+// A lock that the thread holding it may take again. Where threads
+// are not available these do nothing.
+
+typedef struct i_mutex_s i_mutex_t;
+
+i_mutex_t *I_CreateMutex(void);
+void I_LockMutex(i_mutex_t *mutex);
+void I_UnlockMutex(i_mutex_t *mutex);
+
+// Threads kept waiting for work, for jobs split into slices every
+// tic, where starting threads each time would cost more than the
+// job. I_RunPool runs func(args[i]) for each of count slices, slice
+// 0 on the calling thread, and returns when all are done. Slices
+// beyond the pool's threads, or all of them where threads are not
+// available, run on the calling thread in turn.
+
+typedef struct i_pool_s i_pool_t;
+
+i_pool_t *I_CreatePool(int threads);
+void I_RunPool(i_pool_t *pool, thread_func_t func, void **args, int count);
+
 // Add all system-specific config file variable bindings.
 
 void I_BindVariables(void);
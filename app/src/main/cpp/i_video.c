@@ -29,25 +29,6 @@
 #include "doomkeys.h"
 #include "doomgeneric.h"
 
-struct FB_BitField {
-    uint32_t offset; /* beginning of bitfield */
-    uint32_t length; /* length of bitfield */
-};
-
-struct FB_ScreenInfo {
-    uint32_t xres; /* visible resolution */
-    uint32_t yres;
-
-    uint32_t bits_per_pixel; /* guess what */
-
-    /* >1 = FOURCC */
-    struct FB_BitField red; /* bitfield in s_Fb mem if true color, */
-    struct FB_BitField green; /* else only length is significant */
-    struct FB_BitField blue;
-    struct FB_BitField transp; /* transparency */
-};
-
-static struct FB_ScreenInfo s_Fb;
 int fb_scaling = 1;
 int usemouse = 0;
 
@@ -119,24 +100,56 @@ void cmap_to_rgb565(uint16_t *out, uint8_t *in, int in_pixels)
     }
 }
 
-void cmap_to_fb(uint8_t *out, uint8_t *in, int in_pixels)
+// Palette in the framebuffer's pixel format
+
+static uint32_t fb_palette[256];
+
+static void I_UpdateFbPalette(void)
 {
     struct color c;
+
+    for (int i = 0; i < 256; i++)
+    {
+        c = colors[i]; /* R:8 G:8 B:8 format! */
+        fb_palette[i] = ((uint32_t)(c.r >> (8 - DG_ScreenInfo.red.length)) << DG_ScreenInfo.red.offset)
+                      | ((uint32_t)(c.g >> (8 - DG_ScreenInfo.green.length)) << DG_ScreenInfo.green.offset)
+                      | ((uint32_t)(c.b >> (8 - DG_ScreenInfo.blue.length)) << DG_ScreenInfo.blue.offset);
+    }
+}
+
+void cmap_to_fb(uint8_t *out, uint8_t *in, int in_pixels)
+{
     uint32_t pix;
-    uint16_t r, g, b;
+
+    if (DG_ScreenInfo.bits_per_pixel == 32)
+    {
+        uint32_t *out32 = (uint32_t *) out;
+
+        if (fb_scaling == 1)
+        {
+            for (int i = 0; i < in_pixels; i++)
+                out32[i] = fb_palette[in[i]];
+        }
+        else
+        {
+            for (int i = 0; i < in_pixels; i++)
+            {
+                pix = fb_palette[in[i]];
+
+                for (int k = 0; k < fb_scaling; k++)
+                    *out32++ = pix;
+            }
+        }
+
+        return;
+    }
 
     for (int i = 0; i < in_pixels; i++)
     {
-        c = colors[*in]; /* R:8 G:8 B:8 format! */
-        r = (uint16_t)(c.r >> (8 - s_Fb.red.length));
-        g = (uint16_t)(c.g >> (8 - s_Fb.green.length));
-        b = (uint16_t)(c.b >> (8 - s_Fb.blue.length));
-        pix = r << s_Fb.red.offset;
-        pix |= g << s_Fb.green.offset;
-        pix |= b << s_Fb.blue.offset;
+        pix = fb_palette[*in];
 
         for (int k = 0; k < fb_scaling; k++) {
-            for (int j = 0; j < s_Fb.bits_per_pixel/8; j++) {
+            for (int j = 0; j < DG_ScreenInfo.bits_per_pixel/8; j++) {
                 *out = (pix >> (j*8));
                 out++;
             }
@@ -147,38 +160,50 @@ void cmap_to_fb(uint8_t *out, uint8_t *in, int in_pixels)
 
 void I_InitGraphics(void)
 {
-    memset(&s_Fb, 0, sizeof(struct FB_ScreenInfo));
-    s_Fb.xres = DOOMGENERIC_RESX;
-    s_Fb.yres = DOOMGENERIC_RESY;
-    s_Fb.bits_per_pixel = 32;
-
-    s_Fb.blue.length = 8;
-    s_Fb.green.length = 8;
-    s_Fb.red.length = 8;
-    s_Fb.transp.length = 8;
+    /* The backend may have set up its own framebuffer in DG_Init */
+    if (DG_ScreenInfo.xres == 0)
+    {
+        memset(&DG_ScreenInfo, 0, sizeof(struct FB_ScreenInfo));
+        DG_ScreenInfo.xres = DOOMGENERIC_RESX;
+        DG_ScreenInfo.yres = DOOMGENERIC_RESY;
+        DG_ScreenInfo.bits_per_pixel = 32;
+
+        DG_ScreenInfo.blue.length = 8;
+        DG_ScreenInfo.green.length = 8;
+        DG_ScreenInfo.red.length = 8;
+        DG_ScreenInfo.transp.length = 8;
+
+        DG_ScreenInfo.blue.offset = 0;
+        DG_ScreenInfo.green.offset = 8;
+        DG_ScreenInfo.red.offset = 16;
+        DG_ScreenInfo.transp.offset = 24;
+    }
 
-    s_Fb.blue.offset = 0;
-    s_Fb.green.offset = 8;
-    s_Fb.red.offset = 16;
-    s_Fb.transp.offset = 24;
+    if (DG_ScreenInfo.line_length == 0)
+        DG_ScreenInfo.line_length = DG_ScreenInfo.xres * (DG_ScreenInfo.bits_per_pixel/8);
 
     printf("I_InitGraphics: framebuffer: x_res: %d, y_res: %d, bpp: %d\n",
-           s_Fb.xres, s_Fb.yres,  s_Fb.bits_per_pixel);
+           DG_ScreenInfo.xres, DG_ScreenInfo.yres,  DG_ScreenInfo.bits_per_pixel);
 
     printf("I_InitGraphics: framebuffer: RGBA: %d%d%d%d, red_off: %d, green_off: %d, blue_off: %d, transp_off: %d\n",
-           s_Fb.red.length, s_Fb.green.length, s_Fb.blue.length, s_Fb.transp.length, s_Fb.red.offset, s_Fb.green.offset, s_Fb.blue.offset, s_Fb.transp.offset);
+           DG_ScreenInfo.red.length, DG_ScreenInfo.green.length, DG_ScreenInfo.blue.length, DG_ScreenInfo.transp.length, DG_ScreenInfo.red.offset, DG_ScreenInfo.green.offset, DG_ScreenInfo.blue.offset, DG_ScreenInfo.transp.offset);
 
     printf("I_InitGraphics: DOOM screen size: w x h: %d x %d\n", SCREENWIDTH, SCREENHEIGHT);
 
-    fb_scaling = s_Fb.xres / SCREENWIDTH;
-    if (s_Fb.yres / SCREENHEIGHT < fb_scaling)
-        fb_scaling = s_Fb.yres / SCREENHEIGHT;
+    fb_scaling = DG_ScreenInfo.xres / SCREENWIDTH;
+    if (DG_ScreenInfo.yres / SCREENHEIGHT < fb_scaling)
+        fb_scaling = DG_ScreenInfo.yres / SCREENHEIGHT;
+    if (fb_scaling < 1)
+        fb_scaling = 1;
     printf("I_InitGraphics: Auto-scaling factor: %d\n", fb_scaling);
 
     if (DG_ScreenBuffer == NULL) {
         DG_ScreenBuffer = (uint32_t*) malloc(DOOMGENERIC_RESX * DOOMGENERIC_RESY * sizeof(uint32_t));
     }
 
+    /* The palette may have been set before the format was known */
+    I_UpdateFbPalette();
+
     /* Allocate screen to draw to */
     I_VideoBuffer = (byte *) Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);  // For DOOM to draw on
 
@@ -194,16 +219,13 @@ void I_StartTic(void)
 
 void I_FinishUpdate(void)
 {
-    int x_offset, y_offset, x_offset_end;
+    int x_offset, y_offset, line_bytes;
     unsigned char *line_in, *line_out;
 
-    /* Offsets in case FB is bigger than DOOM */
-    /* 600 = s_Fb height, 200 screenheight */
-    /* 600 = s_Fb height, 200 screenheight */
-    /* 2048 =s_Fb width, 320 screenwidth */
-    y_offset     = (((s_Fb.yres - (SCREENHEIGHT * fb_scaling)) * s_Fb.bits_per_pixel/8)) / 2;
-    x_offset     = (((s_Fb.xres - (SCREENWIDTH  * fb_scaling)) * s_Fb.bits_per_pixel/8)) / 2; // XXX: siglent FB hack: /4 instead of /2, since it seems to handle the resolution in a funny way
-    x_offset_end = ((s_Fb.xres - (SCREENWIDTH  * fb_scaling)) * s_Fb.bits_per_pixel/8) - x_offset;
+    /* Offsets in case FB is bigger than DOOM: centre the picture */
+    x_offset = ((DG_ScreenInfo.xres - (SCREENWIDTH  * fb_scaling)) / 2) * (DG_ScreenInfo.bits_per_pixel/8);
+    y_offset = ((DG_ScreenInfo.yres - (SCREENHEIGHT * fb_scaling)) / 2) * DG_ScreenInfo.line_length;
+    line_bytes = SCREENWIDTH * fb_scaling * (DG_ScreenInfo.bits_per_pixel/8);
 
     /* DRAW SCREEN */
     line_in  = (unsigned char *) I_VideoBuffer;
@@ -213,31 +235,26 @@ void I_FinishUpdate(void)
         return;
     }
 
+    line_out += y_offset + x_offset;
+
     int y = SCREENHEIGHT;
 
     while (y--)
     {
-        for (int i = 0; i < fb_scaling; i++)
-        {
-            line_out += x_offset;
+        /* Convert each line once; the rest of a scaled line are copies */
 #ifdef CMAP256
-            for (fb_scaling == 1) {
-                memcpy(line_out, line_in, SCREENWIDTH); /* fb_width is bigger than Doom SCREENWIDTH... */
-            } else {
-                //XXX FIXME fb_scaling support!
-            }
+        memcpy(line_out, line_in, SCREENWIDTH);
 #else
-            //cmap_to_rgb565((void*)line_out, (void*)line_in, SCREENWIDTH);
-            cmap_to_fb((void*)line_out, (void*)line_in, SCREENWIDTH);
+        cmap_to_fb((void*)line_out, (void*)line_in, SCREENWIDTH);
 #endif
-            line_out += (SCREENWIDTH * fb_scaling * (s_Fb.bits_per_pixel/8)) + x_offset_end;
-        }
+        for (int i = 1; i < fb_scaling; i++)
+            memcpy(line_out + i * DG_ScreenInfo.line_length, line_out, line_bytes);
+
+        line_out += fb_scaling * DG_ScreenInfo.line_length;
         line_in += SCREENWIDTH;
     }
 
     DG_DrawFrame();
-    //s_Fb.xres = DG_WindowWidth;
-    //s_Fb.yres = DG_WindowWidth;
 }
 
 void I_ReadScreen(byte *scr)
@@ -261,6 +278,8 @@ void I_SetPalette(byte *palette)
         colors[i].g = gammatable[usegamma][*palette++];
         colors[i].b = gammatable[usegamma][*palette++];
     }
+
+    I_UpdateFbPalette();
 }
 
 // Given an RGB value, find the closest matching palette index.
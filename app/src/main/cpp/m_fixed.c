@@ -43,6 +43,21 @@ FixedMul
 //
 // FixedDiv, C version.
 //
+// On 32-bit targets a 64 by 32 bit division is a library call
+// (__aeabi_ldivmod / __divdi3), so where the FPU has hardware double
+// precision division we divide there instead. The quotient is at most
+// one too large after truncation, which a single multiply corrects,
+// so the result is bit-identical to the 64-bit integer version.
+//
+
+// tools/fixedtest.c defines FIXEDDIV_DOUBLE itself to check this
+// version against the integer one on any machine.
+
+#if !defined(FIXEDDIV_DOUBLE) \
+ && ((defined(__arm__) && defined(__ARM_FP) && (__ARM_FP & 8)) \
+  || (defined(__i386__) && defined(__SSE2__)))
+#define FIXEDDIV_DOUBLE
+#endif
 
 fixed_t FixedDiv(fixed_t a, fixed_t b)
 {
@@ -50,6 +65,27 @@ fixed_t FixedDiv(fixed_t a, fixed_t b)
     {
 	return (a^b) < 0 ? INT_MIN : INT_MAX;
     }
+#ifdef FIXEDDIV_DOUBLE
+    else if (a != INT_MIN)
+    {
+	// Past the overflow check above, |quotient| < 2^31.
+
+	uint32_t ua = a < 0 ? -a : a;
+	uint32_t ub = b < 0 ? -(uint32_t) b : (uint32_t) b;
+	uint32_t q;
+
+	// ua * 65536.0 is exact, and converting from 32 bits keeps to
+	// the FPU; a 64-bit integer would go through __aeabi_ul2d.
+	q = (uint32_t) ((double) ua * 65536.0 / (double) ub);
+
+	if ((uint64_t) q * ub > (uint64_t) ua << FRACBITS)
+	{
+	    --q;
+	}
+
+	return (a^b) < 0 ? -(fixed_t) q : (fixed_t) q;
+    }
+#endif
     else
     {
 	int64_t result;
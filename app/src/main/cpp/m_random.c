@@ -53,6 +53,12 @@ int P_Random (void)
     return rndtable[prndindex];
 }
 
+// Where P_Random has got to, for checking demo sync.
+int P_RandomIndex (void)
+{
+    return prndindex;
+}
+
 int M_Random (void)
 {
     rndindex = (rndindex+1)&0xff;
@@ -32,6 +32,9 @@ int M_Random (void);
 // As M_Random, but used only by the play simulation.
 int P_Random (void);
 
+// The place in the table P_Random has got to.
+int P_RandomIndex (void);
+
 // Fix randoms for demos.
 void M_ClearRandom (void);
 
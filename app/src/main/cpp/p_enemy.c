@@ -89,56 +89,102 @@ void A_Fall (mobj_t *actor);
 
 //
 // Called by P_NoiseAlert.
-// Recursively traverse adjacent sectors,
+// Flood adjacent sectors breadth first,
 // sound blocking lines cut off traversal.
 //
+// Sectors reached without crossing a sound blocking line get
+// soundtraversed 1 and are all flooded first; those reached by
+// crossing one get 2.  That is the same result the original
+// recursive walk came to, revisiting sectors until each had its
+// lowest count, without the revisits.
+//
 
 mobj_t*		soundtarget;
 
-void
-P_RecursiveSound
-( sector_t*	sec,
+static int
+P_FloodSound
+( int		head,
+  int		tail,
   int		soundblocks )
 {
-    int		i;
-    line_t*	check;
-    sector_t*	other;
-	
-    // wake up all monsters in this sector
-    if (sec->validcount == validcount
-	&& sec->soundtraversed <= soundblocks+1)
+    int			i;
+    sector_t*		sec;
+    sector_t*		other;
+    sectoradj_t*	adj;
+
+    while (head < tail)
     {
-	return;		// already flooded
+	sec = sectorqueue[head++];
+
+	for (i=0, adj=sec->adj ; i<sec->adjcount ; i++, adj++)
+	{
+	    other = adj->sector;
+
+	    if (other->validcount == validcount
+	     || (adj->line->flags & ML_SOUNDBLOCK))
+		continue;
+
+	    P_LineOpening (adj->line);
+
+	    if (openrange <= 0)
+		continue;	// closed door
+
+	    other->validcount = validcount;
+	    other->soundtraversed = soundblocks+1;
+	    other->soundtarget = soundtarget;
+	    sectorqueue[tail++] = other;
+	}
     }
-    
-    sec->validcount = validcount;
-    sec->soundtraversed = soundblocks+1;
-    sec->soundtarget = soundtarget;
-	
-    for (i=0 ;i<sec->linecount ; i++)
+
+    return tail;
+}
+
+static void P_SoundSectors (sector_t* start)
+{
+    int			i;
+    int			j;
+    int			tail;
+    int			unblocked;
+    sector_t*		sec;
+    sector_t*		other;
+    sectoradj_t*	adj;
+
+    start->validcount = validcount;
+    start->soundtraversed = 1;
+    start->soundtarget = soundtarget;
+    sectorqueue[0] = start;
+
+    unblocked = P_FloodSound (0, 1, 0);
+
+    // step once through the sound blocking lines out of
+    // the unblocked sectors and carry on from there
+    tail = unblocked;
+
+    for (i=0 ; i<unblocked ; i++)
     {
-	check = sec->lines[i];
-	if (! (check->flags & ML_TWOSIDED) )
-	    continue;
-	
-	P_LineOpening (check);
+	sec = sectorqueue[i];
 
-	if (openrange <= 0)
-	    continue;	// closed door
-	
-	if ( sides[ check->sidenum[0] ].sector == sec)
-	    other = sides[ check->sidenum[1] ] .sector;
-	else
-	    other = sides[ check->sidenum[0] ].sector;
-	
-	if (check->flags & ML_SOUNDBLOCK)
+	for (j=0, adj=sec->adj ; j<sec->adjcount ; j++, adj++)
 	{
-	    if (!soundblocks)
-		P_RecursiveSound (other, 1);
+	    other = adj->sector;
+
+	    if (other->validcount == validcount
+	     || !(adj->line->flags & ML_SOUNDBLOCK))
+		continue;
+
+	    P_LineOpening (adj->line);
+
+	    if (openrange <= 0)
+		continue;
+
+	    other->validcount = validcount;
+	    other->soundtraversed = 2;
+	    other->soundtarget = soundtarget;
+	    sectorqueue[tail++] = other;
 	}
-	else
-	    P_RecursiveSound (other, soundblocks);
     }
+
+    P_FloodSound (unblocked, tail, 1);
 }
 
 
@@ -155,7 +201,7 @@ P_NoiseAlert
 {
     soundtarget = target;
     validcount++;
-    P_RecursiveSound (emmiter->subsector->sector, 0);
+    P_SoundSectors (emmiter->subsector->sector);
 }
 
 
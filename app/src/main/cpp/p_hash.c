@@ -0,0 +1,403 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-tic hashes of the play simulation.
+//
+//	With -statehash, every player, mobj and sector is hashed at the
+//	end of each tic in a level, and the hashes written out along
+//	with the P_Random index.  Only the hashes that changed since the
+//	tic before are written, so a stream is small enough to keep for
+//	a long demo.  tools/hashcmp.c reads the streams written by two
+//	builds side by side and reports the first tic, and the objects,
+//	where they differ.
+//
+//	Layout, numbers little endian, "var" an unsigned LEB128 number:
+//
+//	    "STHS" version(byte)
+//	    for each tic:
+//	        tic(var) prndindex(byte)
+//	        for players, then mobjs, then sectors:
+//	            count(var) changed(var)
+//	            changed of:
+//	                index(var) hash(32)
+//	                mobjs only: type(var) x(16) y(16)
+//
+//	Players are all MAXPLAYERS slots, hashed as 0 if not in the
+//	game; mobjs are numbered in thinker order, and sectors as in
+//	the map.  An object past the end of its group the tic before
+//	always counts as changed.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_system.h"
+#include "m_argv.h"
+#include "m_random.h"
+#include "p_hash.h"
+#include "p_local.h"
+
+#include "r_state.h"
+
+typedef struct
+{
+    unsigned int *hashes;
+    int count;
+    int alloced;
+} hashgroup_t;
+
+static FILE *hashfile;
+static hashgroup_t groups[NUMSTATEHASHGROUPS];
+
+// FNV-1a, a byte at a time.
+
+static unsigned int HashInt (unsigned int hash, int value)
+{
+    int i;
+
+    for (i=0 ; i<4 ; i++)
+    {
+        hash = (hash ^ (value & 0xff)) * 16777619u;
+        value >>= 8;
+    }
+
+    return hash;
+}
+
+#define HASHSTART	2166136261u
+
+static unsigned int HashPlayer (player_t *player)
+{
+    unsigned int h = HASHSTART;
+    int i;
+
+    h = HashInt (h, player->playerstate);
+    h = HashInt (h, player->cmd.forwardmove);
+    h = HashInt (h, player->cmd.sidemove);
+    h = HashInt (h, player->cmd.angleturn);
+    h = HashInt (h, player->cmd.buttons);
+    h = HashInt (h, player->viewz);
+    h = HashInt (h, player->viewheight);
+    h = HashInt (h, player->deltaviewheight);
+    h = HashInt (h, player->bob);
+    h = HashInt (h, player->health);
+    h = HashInt (h, player->armorpoints);
+    h = HashInt (h, player->armortype);
+    h = HashInt (h, player->backpack);
+    h = HashInt (h, player->readyweapon);
+    h = HashInt (h, player->pendingweapon);
+    h = HashInt (h, player->attackdown);
+    h = HashInt (h, player->usedown);
+    h = HashInt (h, player->cheats);
+    h = HashInt (h, player->refire);
+    h = HashInt (h, player->killcount);
+    h = HashInt (h, player->itemcount);
+    h = HashInt (h, player->secretcount);
+    h = HashInt (h, player->damagecount);
+    h = HashInt (h, player->bonuscount);
+    h = HashInt (h, player->extralight);
+    h = HashInt (h, player->fixedcolormap);
+
+    for (i=0 ; i<NUMPOWERS ; i++)
+	h = HashInt (h, player->powers[i]);
+    for (i=0 ; i<NUMCARDS ; i++)
+	h = HashInt (h, player->cards[i]);
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	h = HashInt (h, player->frags[i]);
+    for (i=0 ; i<NUMWEAPONS ; i++)
+	h = HashInt (h, player->weaponowned[i]);
+    for (i=0 ; i<NUMAMMO ; i++)
+    {
+	h = HashInt (h, player->ammo[i]);
+	h = HashInt (h, player->maxammo[i]);
+    }
+
+    for (i=0 ; i<NUMPSPRITES ; i++)
+    {
+	pspdef_t *psp = &player->psprites[i];
+
+	h = HashInt (h, psp->state ? psp->state - states : -1);
+	h = HashInt (h, psp->tics);
+	h = HashInt (h, psp->sx);
+	h = HashInt (h, psp->sy);
+    }
+
+    return h;
+}
+
+// Pointers to other mobjs cannot be hashed as they are, so
+// only what the mobj points at is.
+
+static unsigned int HashMobj (mobj_t *mo)
+{
+    unsigned int h = HASHSTART;
+
+    h = HashInt (h, mo->type);
+    h = HashInt (h, mo->x);
+    h = HashInt (h, mo->y);
+    h = HashInt (h, mo->z);
+    h = HashInt (h, mo->angle);
+    h = HashInt (h, mo->sprite);
+    h = HashInt (h, mo->frame);
+    h = HashInt (h, mo->floorz);
+    h = HashInt (h, mo->ceilingz);
+    h = HashInt (h, mo->radius);
+    h = HashInt (h, mo->height);
+    h = HashInt (h, mo->momx);
+    h = HashInt (h, mo->momy);
+    h = HashInt (h, mo->momz);
+    h = HashInt (h, mo->tics);
+    h = HashInt (h, mo->state ? mo->state - states : -1);
+    h = HashInt (h, mo->flags);
+    h = HashInt (h, mo->health);
+    h = HashInt (h, mo->movedir);
+    h = HashInt (h, mo->movecount);
+    h = HashInt (h, mo->reactiontime);
+    h = HashInt (h, mo->threshold);
+    h = HashInt (h, mo->lastlook);
+    h = HashInt (h, mo->target ? (int) mo->target->type : -1);
+    h = HashInt (h, mo->tracer ? (int) mo->tracer->type : -1);
+    h = HashInt (h, mo->player ? mo->player - players : -1);
+
+    return h;
+}
+
+static unsigned int HashSector (sector_t *sec)
+{
+    unsigned int h = HASHSTART;
+
+    h = HashInt (h, sec->floorheight);
+    h = HashInt (h, sec->ceilingheight);
+    h = HashInt (h, sec->floorpic);
+    h = HashInt (h, sec->ceilingpic);
+    h = HashInt (h, sec->lightlevel);
+    h = HashInt (h, sec->special);
+    h = HashInt (h, sec->tag);
+    h = HashInt (h, sec->soundtraversed);
+    h = HashInt (h, sec->soundtarget ? (int) sec->soundtarget->type : -1);
+    h = HashInt (h, sec->specialdata != NULL);
+
+    return h;
+}
+
+static void WriteVar (unsigned int value)
+{
+    while (value >= 0x80)
+    {
+	putc ((value & 0x7f) | 0x80, hashfile);
+	value >>= 7;
+    }
+
+    putc (value, hashfile);
+}
+
+static void WriteShort (int value)
+{
+    putc (value & 0xff, hashfile);
+    putc ((value >> 8) & 0xff, hashfile);
+}
+
+static void WriteLong (unsigned int value)
+{
+    WriteShort (value & 0xffff);
+    WriteShort (value >> 16);
+}
+
+//
+// Make room for count hashes in a group. The new ones are
+// changed by definition, so what they start as does not matter.
+//
+static void GrowGroup (hashgroup_t *group, int count)
+{
+    if (count > group->alloced)
+    {
+	group->alloced = count * 2;
+	group->hashes = realloc (group->hashes,
+				 group->alloced * sizeof(unsigned int));
+
+	if (group->hashes == NULL)
+	    I_Error ("P_WriteStateHash: out of memory");
+    }
+}
+
+//
+// Write the hashes of one group that differ from the tic before.
+// mobjs is non-NULL for the mobj group, which also gets where
+// each changed mobj is, to make reports easier to follow.
+//
+static void WriteGroup (hashgroup_t *group, unsigned int *hashes,
+			mobj_t **mobjs, int count)
+{
+    int changed;
+    int i;
+
+    changed = 0;
+
+    for (i=0 ; i<count ; i++)
+    {
+	if (i >= group->count || hashes[i] != group->hashes[i])
+	    changed++;
+    }
+
+    WriteVar (count);
+    WriteVar (changed);
+
+    for (i=0 ; i<count ; i++)
+    {
+	if (i < group->count && hashes[i] == group->hashes[i])
+	    continue;
+
+	WriteVar (i);
+	WriteLong (hashes[i]);
+
+	if (mobjs != NULL)
+	{
+	    WriteVar (mobjs[i]->type);
+	    WriteShort (mobjs[i]->x >> FRACBITS);
+	    WriteShort (mobjs[i]->y >> FRACBITS);
+	}
+    }
+
+    GrowGroup (group, count);
+    memcpy (group->hashes, hashes, count * sizeof(unsigned int));
+    group->count = count;
+}
+
+static void CloseStateHash (void)
+{
+    if (hashfile != NULL)
+    {
+	fclose (hashfile);
+	hashfile = NULL;
+    }
+}
+
+void P_InitStateHash (void)
+{
+    int p;
+
+    //!
+    // @arg <file>
+    // @category demo
+    //
+    // Write a hash of every player, mobj and sector at the end of
+    // each tic to the given file, to compare with tools/hashcmp.
+    //
+
+    p = M_CheckParmWithArgs ("-statehash", 1);
+
+    if (!p)
+	return;
+
+    hashfile = fopen (myargv[p+1], "wb");
+
+    if (hashfile == NULL)
+	I_Error ("P_InitStateHash: Unable to open %s", myargv[p+1]);
+
+    fwrite ("STHS", 1, 4, hashfile);
+    putc (STATEHASH_VERSION, hashfile);
+
+    // A desync often ends in an error; keep what led up to it.
+    I_AtExit (CloseStateHash, true);
+}
+
+void P_WriteStateHash (int tic)
+{
+    static unsigned int *hashes;
+    static mobj_t **mobjs;
+    static int alloced;
+    thinker_t *th;
+    int count;
+    int i;
+
+    if (hashfile == NULL)
+	return;
+
+    WriteVar (tic);
+    putc (P_RandomIndex (), hashfile);
+
+    count = MAXPLAYERS;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+	if (th->function.acp1 == (actionf_p1) P_MobjThinker)
+	    count++;
+    }
+
+    if (numsectors > count)
+	count = numsectors;
+
+    if (count > alloced)
+    {
+	alloced = count * 2;
+	hashes = realloc (hashes, alloced * sizeof(unsigned int));
+	mobjs = realloc (mobjs, alloced * sizeof(mobj_t *));
+
+	if (hashes == NULL || mobjs == NULL)
+	    I_Error ("P_WriteStateHash: out of memory");
+    }
+
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	hashes[i] = playeringame[i] ? HashPlayer (&players[i]) : 0;
+
+    WriteGroup (&groups[STATEHASH_PLAYERS], hashes, NULL, MAXPLAYERS);
+
+    count = 0;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+	if (th->function.acp1 == (actionf_p1) P_MobjThinker)
+	{
+	    mobjs[count] = (mobj_t *) th;
+	    hashes[count] = HashMobj (mobjs[count]);
+	    count++;
+	}
+    }
+
+    WriteGroup (&groups[STATEHASH_MOBJS], hashes, mobjs, count);
+
+    for (i=0 ; i<numsectors ; i++)
+	hashes[i] = HashSector (&sectors[i]);
+
+    WriteGroup (&groups[STATEHASH_SECTORS], hashes, NULL, numsectors);
+}
+
+void P_HashLevel (sha1_context_t *sha1)
+{
+    thinker_t *th;
+    int i;
+
+    SHA1_UpdateInt32 (sha1, gameepisode);
+    SHA1_UpdateInt32 (sha1, gamemap);
+    SHA1_UpdateInt32 (sha1, leveltime);
+    SHA1_UpdateInt32 (sha1, P_RandomIndex ());
+
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	SHA1_UpdateInt32 (sha1, playeringame[i] ? HashPlayer (&players[i]) : 0);
+
+    // in thinker order, which the game keeps the same from run to run
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+	if (th->function.acp1 == (actionf_p1) P_MobjThinker)
+	    SHA1_UpdateInt32 (sha1, HashMobj ((mobj_t *) th));
+    }
+
+    for (i=0 ; i<numsectors ; i++)
+	SHA1_UpdateInt32 (sha1, HashSector (&sectors[i]));
+}
+
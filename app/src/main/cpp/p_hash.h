@@ -0,0 +1,48 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Per-tic hashes of the play simulation, for checking that two
+//	builds play a demo the same.
+//
+
+
+#ifndef __P_HASH__
+#define __P_HASH__
+
+#include "sha1.h"
+
+#define STATEHASH_VERSION	1
+
+// Groups of objects, in the order they are written each tic.
+enum
+{
+    STATEHASH_PLAYERS,
+    STATEHASH_MOBJS,
+    STATEHASH_SECTORS,
+    NUMSTATEHASHGROUPS
+};
+
+// Open the stream, if -statehash was given.
+void P_InitStateHash (void);
+
+// Called at the end of each tic in a level.
+void P_WriteStateHash (int tic);
+
+// Add the whole level, hashed as above, to a SHA-1. Nothing that
+// depends on where things are in memory goes in, so the same game
+// hashes the same in any run of any build.
+void P_HashLevel (sha1_context_t *sha1);
+
+#endif
+
@@ -66,7 +66,7 @@ void P_SpawnFireFlicker (sector_t*	sector)
     // Nothing special about it during gameplay.
     sector->special = 0; 
 	
-    flick = Z_Malloc ( sizeof(*flick), PU_LEVSPEC, 0);
+    flick = Z_SlabAlloc (&fireflickerslab);
 
     P_AddThinker (&flick->thinker);
 
@@ -121,7 +121,7 @@ void P_SpawnLightFlash (sector_t*	sector)
     // nothing special about it during gameplay
     sector->special = 0;	
 	
-    flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
+    flash = Z_SlabAlloc (&lightflashslab);
 
     P_AddThinker (&flash->thinker);
 
@@ -178,7 +178,7 @@ P_SpawnStrobeFlash
 {
     strobe_t*	flash;
 	
-    flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
+    flash = Z_SlabAlloc (&strobeslab);
 
     P_AddThinker (&flash->thinker);
 
@@ -233,7 +233,6 @@ void EV_TurnTagLightsOff(line_t* line)
     int			min;
     sector_t*		sector;
     sector_t*		tsec;
-    line_t*		templine;
 	
     sector = sectors;
     
@@ -242,12 +241,9 @@ void EV_TurnTagLightsOff(line_t* line)
 	if (sector->tag == line->tag)
 	{
 	    min = sector->lightlevel;
-	    for (i = 0;i < sector->linecount; i++)
+	    for (i = 0;i < sector->adjcount; i++)
 	    {
-		templine = sector->lines[i];
-		tsec = getNextSector(templine,sector);
-		if (!tsec)
-		    continue;
+		tsec = sector->adj[i].sector;
 		if (tsec->lightlevel < min)
 		    min = tsec->lightlevel;
 	    }
@@ -269,7 +265,6 @@ EV_LightTurnOn
     int		j;
     sector_t*	sector;
     sector_t*	temp;
-    line_t*	templine;
 	
     sector = sectors;
 	
@@ -282,13 +277,9 @@ EV_LightTurnOn
 	    // surrounding sector
 	    if (!bright)
 	    {
-		for (j = 0;j < sector->linecount; j++)
+		for (j = 0;j < sector->adjcount; j++)
 		{
-		    templine = sector->lines[j];
-		    temp = getNextSector(templine,sector);
-
-		    if (!temp)
-			continue;
+		    temp = sector->adj[j].sector;
 
 		    if (temp->lightlevel > bright)
 			bright = temp->lightlevel;
@@ -335,7 +326,7 @@ void P_SpawnGlowingLight(sector_t*	sector)
 {
     glow_t*	g;
 	
-    g = Z_Malloc( sizeof(*g), PU_LEVSPEC, 0);
+    g = Z_SlabAlloc (&glowslab);
 
     P_AddThinker(&g->thinker);
 
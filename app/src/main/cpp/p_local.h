@@ -24,6 +24,8 @@
 #include "r_local.h"
 #endif
 
+#include "z_zone.h"
+
 #define FLOATSPEED		(FRACUNIT*4)
 
 
@@ -71,6 +73,17 @@ void P_InitThinkers (void);
 void P_AddThinker (thinker_t* thinker);
 void P_RemoveThinker (thinker_t* thinker);
 
+// thinker allocation, one zone slab per type
+extern	zslab_t		mobjslab;
+extern	zslab_t		ceilingslab;
+extern	zslab_t		doorslab;
+extern	zslab_t		floorslab;
+extern	zslab_t		platslab;
+extern	zslab_t		fireflickerslab;
+extern	zslab_t		lightflashslab;
+extern	zslab_t		strobeslab;
+extern	zslab_t		glowslab;
+
 
 //
 // P_PSPR
@@ -226,7 +239,6 @@ boolean P_CheckPosition (mobj_t *thing, fixed_t x, fixed_t y);
 boolean P_TryMove (mobj_t* thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove (mobj_t* thing, fixed_t x, fixed_t y);
 void	P_SlideMove (mobj_t* mo);
-boolean P_CheckSight (mobj_t* t1, mobj_t* t2);
 void 	P_UseLines (player_t* player);
 
 boolean P_ChangeSector (sector_t* sector, boolean crunch);
@@ -255,6 +267,18 @@ P_RadiusAttack
 
 
 
+//
+// P_SIGHT
+//
+extern int		sightthreads;
+extern int		sectorheightgen;
+
+boolean P_CheckSight (mobj_t* t1, mobj_t* t2);
+void	P_SetSightThreads (int threads);
+void	P_RunSightPrepass (void);
+void	P_EndSightPrepass (void);
+
+
 //
 // P_SETUP
 //
@@ -266,6 +290,7 @@ extern int		bmapheight;	// in mapblocks
 extern fixed_t		bmaporgx;
 extern fixed_t		bmaporgy;	// origin of block map
 extern mobj_t**		blocklinks;	// for thing chains
+extern sector_t**	sectorqueue;	// [numsectors] for sector floods
 
 
 
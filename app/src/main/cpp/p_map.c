@@ -831,8 +831,8 @@ fixed_t		attackrange;
 fixed_t		aimslope;
 
 // slopes to top and bottom of target
-extern fixed_t	topslope;
-extern fixed_t	bottomslope;	
+fixed_t		topslope;
+fixed_t		bottomslope;	
 
 
 //
@@ -36,7 +36,7 @@
 #define SAVEGAME_EOF 0x1d
 #define VERSIONSIZE 16 
 
-FILE *save_stream;
+MEMFILE *save_stream;
 int savegamelength;
 boolean savegame_error;
 
@@ -56,6 +56,20 @@ char *P_TempSaveGameFile(void)
     return filename;
 }
 
+// Get the filename of the snapshot written when the game is suspended.
+
+char *P_SuspendGameFile(void)
+{
+    static char *filename = NULL;
+
+    if (filename == NULL)
+    {
+        filename = M_StringJoin(savegamedir, "suspend.dsg", NULL);
+    }
+
+    return filename;
+}
+
 // Get the filename of the save game file to use for the specified slot.
 
 char *P_SaveGameFile(int slot)
@@ -82,7 +96,7 @@ static byte saveg_read8(void)
 {
     byte result;
 
-    if (fread(&result, 1, 1, save_stream) < 1)
+    if (mem_fread(&result, 1, 1, save_stream) < 1)
     {
         if (!savegame_error)
         {
@@ -98,7 +112,7 @@ static byte saveg_read8(void)
 
 static void saveg_write8(byte value)
 {
-    if (fwrite(&value, 1, 1, save_stream) < 1)
+    if (mem_fwrite(&value, 1, 1, save_stream) < 1)
     {
         if (!savegame_error)
         {
@@ -153,7 +167,7 @@ static void saveg_read_pad(void)
     int padding;
     int i;
 
-    pos = ftell(save_stream);
+    pos = mem_ftell(save_stream);
 
     padding = (4 - (pos & 3)) & 3;
 
@@ -169,7 +183,7 @@ static void saveg_write_pad(void)
     int padding;
     int i;
 
-    pos = ftell(save_stream);
+    pos = mem_ftell(save_stream);
 
     padding = (4 - (pos & 3)) & 3;
 
@@ -1633,7 +1647,7 @@ void P_UnArchiveThinkers (void)
 	if (currentthinker->function.acp1 == (actionf_p1)P_MobjThinker)
 	    P_RemoveMobj ((mobj_t *)currentthinker);
 	else
-	    Z_Free (currentthinker);
+	    Z_SlabFree (currentthinker);
 
 	currentthinker = next;
     }
@@ -1650,7 +1664,7 @@ void P_UnArchiveThinkers (void)
 			
 	  case tc_mobj:
 	    saveg_read_pad();
-	    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
+	    mobj = Z_SlabAlloc (&mobjslab);
             saveg_read_mobj_t(mobj);
 
 	    mobj->target = NULL;
@@ -1701,84 +1715,97 @@ enum
 // T_Glow, (glow_t: sector_t *),
 // T_PlatRaise, (plat_t: sector_t *), - active list
 //
+
+//
+// saveg_special_class
+// The tc_ class of a special thinker, or -1 if it is not one.
+//
+static int saveg_special_class(thinker_t *th)
+{
+    int			i;
+
+    if (th->function.acv == (actionf_v)NULL)
+    {
+	for (i = 0; i < MAXCEILINGS;i++)
+	    if (activeceilings[i] == (ceiling_t *)th)
+		return tc_ceiling;
+
+	return -1;
+    }
+
+    if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
+	return tc_ceiling;
+
+    if (th->function.acp1 == (actionf_p1)T_VerticalDoor)
+	return tc_door;
+
+    if (th->function.acp1 == (actionf_p1)T_MoveFloor)
+	return tc_floor;
+
+    if (th->function.acp1 == (actionf_p1)T_PlatRaise)
+	return tc_plat;
+
+    if (th->function.acp1 == (actionf_p1)T_LightFlash)
+	return tc_flash;
+
+    if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
+	return tc_strobe;
+
+    if (th->function.acp1 == (actionf_p1)T_Glow)
+	return tc_glow;
+
+    return -1;
+}
+
+static void saveg_write_special(thinker_t *th, int tclass)
+{
+    saveg_write8(tclass);
+    saveg_write_pad();
+
+    switch (tclass)
+    {
+      case tc_ceiling:
+	saveg_write_ceiling_t((ceiling_t *) th);
+	break;
+
+      case tc_door:
+	saveg_write_vldoor_t((vldoor_t *) th);
+	break;
+
+      case tc_floor:
+	saveg_write_floormove_t((floormove_t *) th);
+	break;
+
+      case tc_plat:
+	saveg_write_plat_t((plat_t *) th);
+	break;
+
+      case tc_flash:
+	saveg_write_lightflash_t((lightflash_t *) th);
+	break;
+
+      case tc_strobe:
+	saveg_write_strobe_t((strobe_t *) th);
+	break;
+
+      case tc_glow:
+	saveg_write_glow_t((glow_t *) th);
+	break;
+    }
+}
+
 void P_ArchiveSpecials (void)
 {
     thinker_t*		th;
-    int			i;
+    int			tclass;
 	
     // save off the current thinkers
     for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
     {
-	if (th->function.acv == (actionf_v)NULL)
-	{
-	    for (i = 0; i < MAXCEILINGS;i++)
-		if (activeceilings[i] == (ceiling_t *)th)
-		    break;
-	    
-	    if (i<MAXCEILINGS)
-	    {
-                saveg_write8(tc_ceiling);
-		saveg_write_pad();
-                saveg_write_ceiling_t((ceiling_t *) th);
-	    }
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
-	{
-            saveg_write8(tc_ceiling);
-	    saveg_write_pad();
-            saveg_write_ceiling_t((ceiling_t *) th);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_VerticalDoor)
-	{
-            saveg_write8(tc_door);
-	    saveg_write_pad();
-            saveg_write_vldoor_t((vldoor_t *) th);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_MoveFloor)
-	{
-            saveg_write8(tc_floor);
-	    saveg_write_pad();
-            saveg_write_floormove_t((floormove_t *) th);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_PlatRaise)
-	{
-            saveg_write8(tc_plat);
-	    saveg_write_pad();
-            saveg_write_plat_t((plat_t *) th);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_LightFlash)
-	{
-            saveg_write8(tc_flash);
-	    saveg_write_pad();
-            saveg_write_lightflash_t((lightflash_t *) th);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
-	{
-            saveg_write8(tc_strobe);
-	    saveg_write_pad();
-            saveg_write_strobe_t((strobe_t *) th);
-	    continue;
-	}
-			
-	if (th->function.acp1 == (actionf_p1)T_Glow)
-	{
-            saveg_write8(tc_glow);
-	    saveg_write_pad();
-            saveg_write_glow_t((glow_t *) th);
-	    continue;
-	}
+	tclass = saveg_special_class(th);
+
+	if (tclass >= 0)
+	    saveg_write_special(th, tclass);
     }
 	
     // add a terminating marker
@@ -1788,11 +1815,11 @@ void P_ArchiveSpecials (void)
 
 
 //
-// P_UnArchiveSpecials
+// saveg_read_special
+// Reads a special of the given class and starts it up again.
 //
-void P_UnArchiveSpecials (void)
+static void saveg_read_special(int tclass)
 {
-    byte		tclass;
     ceiling_t*		ceiling;
     vldoor_t*		door;
     floormove_t*	floor;
@@ -1800,92 +1827,570 @@ void P_UnArchiveSpecials (void)
     lightflash_t*	flash;
     strobe_t*		strobe;
     glow_t*		glow;
-	
-	
-    // read in saved thinkers
-    while (1)
-    {
-	tclass = saveg_read8();
 
-	switch (tclass)
-	{
-	  case tc_endspecials:
-	    return;	// end of list
-			
-	  case tc_ceiling:
-	    saveg_read_pad();
-	    ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
-            saveg_read_ceiling_t(ceiling);
-	    ceiling->sector->specialdata = ceiling;
+    switch (tclass)
+    {
+      case tc_ceiling:
+	saveg_read_pad();
+	ceiling = Z_SlabAlloc (&ceilingslab);
+	saveg_read_ceiling_t(ceiling);
+	ceiling->sector->specialdata = ceiling;
 
-	    if (ceiling->thinker.function.acp1)
-		ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
+	if (ceiling->thinker.function.acp1)
+	    ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
 
-	    P_AddThinker (&ceiling->thinker);
-	    P_AddActiveCeiling(ceiling);
-	    break;
+	P_AddThinker (&ceiling->thinker);
+	P_AddActiveCeiling(ceiling);
+	break;
 				
-	  case tc_door:
-	    saveg_read_pad();
-	    door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
-            saveg_read_vldoor_t(door);
-	    door->sector->specialdata = door;
-	    door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
-	    P_AddThinker (&door->thinker);
-	    break;
+      case tc_door:
+	saveg_read_pad();
+	door = Z_SlabAlloc (&doorslab);
+	saveg_read_vldoor_t(door);
+	door->sector->specialdata = door;
+	door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
+	P_AddThinker (&door->thinker);
+	break;
 				
-	  case tc_floor:
-	    saveg_read_pad();
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
-            saveg_read_floormove_t(floor);
-	    floor->sector->specialdata = floor;
-	    floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
-	    P_AddThinker (&floor->thinker);
-	    break;
+      case tc_floor:
+	saveg_read_pad();
+	floor = Z_SlabAlloc (&floorslab);
+	saveg_read_floormove_t(floor);
+	floor->sector->specialdata = floor;
+	floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
+	P_AddThinker (&floor->thinker);
+	break;
 				
-	  case tc_plat:
-	    saveg_read_pad();
-	    plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
-            saveg_read_plat_t(plat);
-	    plat->sector->specialdata = plat;
+      case tc_plat:
+	saveg_read_pad();
+	plat = Z_SlabAlloc (&platslab);
+	saveg_read_plat_t(plat);
+	plat->sector->specialdata = plat;
 
-	    if (plat->thinker.function.acp1)
-		plat->thinker.function.acp1 = (actionf_p1)T_PlatRaise;
+	if (plat->thinker.function.acp1)
+	    plat->thinker.function.acp1 = (actionf_p1)T_PlatRaise;
 
-	    P_AddThinker (&plat->thinker);
-	    P_AddActivePlat(plat);
-	    break;
+	P_AddThinker (&plat->thinker);
+	P_AddActivePlat(plat);
+	break;
 				
-	  case tc_flash:
-	    saveg_read_pad();
-	    flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
-            saveg_read_lightflash_t(flash);
-	    flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
-	    P_AddThinker (&flash->thinker);
-	    break;
+      case tc_flash:
+	saveg_read_pad();
+	flash = Z_SlabAlloc (&lightflashslab);
+	saveg_read_lightflash_t(flash);
+	flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
+	P_AddThinker (&flash->thinker);
+	break;
 				
-	  case tc_strobe:
-	    saveg_read_pad();
-	    strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
-            saveg_read_strobe_t(strobe);
-	    strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
-	    P_AddThinker (&strobe->thinker);
-	    break;
+      case tc_strobe:
+	saveg_read_pad();
+	strobe = Z_SlabAlloc (&strobeslab);
+	saveg_read_strobe_t(strobe);
+	strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
+	P_AddThinker (&strobe->thinker);
+	break;
 				
-	  case tc_glow:
-	    saveg_read_pad();
-	    glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
-            saveg_read_glow_t(glow);
-	    glow->thinker.function.acp1 = (actionf_p1)T_Glow;
-	    P_AddThinker (&glow->thinker);
-	    break;
+      case tc_glow:
+	saveg_read_pad();
+	glow = Z_SlabAlloc (&glowslab);
+	saveg_read_glow_t(glow);
+	glow->thinker.function.acp1 = (actionf_p1)T_Glow;
+	P_AddThinker (&glow->thinker);
+	break;
 				
-	  default:
-	    I_Error ("P_UnarchiveSpecials:Unknown tclass %i "
-		     "in savegame",tclass);
-	}
+      default:
+	I_Error ("P_UnarchiveSpecials:Unknown tclass %i "
+		 "in savegame",tclass);
+    }
+}
+
+
+//
+// P_UnArchiveSpecials
+//
+void P_UnArchiveSpecials (void)
+{
+    byte		tclass;
 	
+    // read in saved thinkers
+    while (1)
+    {
+	tclass = saveg_read8();
+
+	if (tclass == tc_endspecials)
+	    return;	// end of list
+
+	saveg_read_special(tclass);
+    }
+}
+
+
+
+//
+// SNAPSHOTS
+// A snapshot stores the level exactly, so that a demo played on from
+// one stays in sync: thinkers keep their order, references between
+// mobjs are kept (as positions in the thinker list), the sector and
+// blockmap thing lists keep their order, and the random number
+// generators are saved along with the other level globals.
+//
+enum
+{
+    sc_end,
+    sc_mobj,
+    sc_removedmobj,		// removed, freed on the next tic
+    sc_special
+};
+
+typedef struct
+{
+    mobj_t*	mobj;
+    int		id;
+} snapshotid_t;
+
+extern int		prndindex;
+extern mobj_t*		braintargets[32];
+extern int		numbraintargets;
+extern int		braintargeton;
+
+static snapshotid_t*	snapshotids;
+static mobj_t**		snapshotmobjs;
+static int		numsnapshotmobjs;
+
+static int saveg_compare_ids(const void *a, const void *b)
+{
+    const snapshotid_t *ia = a;
+    const snapshotid_t *ib = b;
+
+    if (ia->mobj == ib->mobj)
+        return 0;
+
+    return (uintptr_t) ia->mobj < (uintptr_t) ib->mobj ? -1 : 1;
+}
+
+static boolean saveg_is_mobj(thinker_t *th)
+{
+    if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+        return true;
+
+    // removed mobjs stay in the list, and may still be pointed to,
+    // until the next tic
+    return th->function.acv == (actionf_v)(-1)
+        && Z_SlabOf(th) == &mobjslab;
+}
+
+static void saveg_write_mobjref(mobj_t *mobj)
+{
+    snapshotid_t key;
+    snapshotid_t *found;
+
+    found = NULL;
+
+    if (mobj != NULL)
+    {
+        key.mobj = mobj;
+        found = bsearch(&key, snapshotids, numsnapshotmobjs,
+                        sizeof(snapshotid_t), saveg_compare_ids);
     }
 
+    saveg_write32(found != NULL ? found->id : -1);
 }
 
+static mobj_t *saveg_read_mobjref(void)
+{
+    int id;
+
+    id = saveg_read32();
+
+    if (id < 0 || id >= numsnapshotmobjs)
+        return NULL;
+
+    return snapshotmobjs[id];
+}
+
+//
+// P_ArchiveSnapshot
+//
+void P_ArchiveSnapshot (void)
+{
+    thinker_t*		th;
+    mobj_t*		mobj;
+    sector_t*		sec;
+    line_t*		li;
+    side_t*		si;
+    int			tclass;
+    int			i;
+    int			j;
+
+    // number the mobjs in thinker order
+    numsnapshotmobjs = 0;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+        if (saveg_is_mobj(th))
+            ++numsnapshotmobjs;
+    }
+
+    snapshotids = Z_Malloc((numsnapshotmobjs + 1) * sizeof(snapshotid_t),
+                           PU_STATIC, NULL);
+    i = 0;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+        if (saveg_is_mobj(th))
+        {
+            snapshotids[i].mobj = (mobj_t *) th;
+            snapshotids[i].id = i;
+            ++i;
+        }
+    }
+
+    qsort(snapshotids, numsnapshotmobjs, sizeof(snapshotid_t),
+          saveg_compare_ids);
+
+    // level globals
+    saveg_write32(prndindex);
+    saveg_write32(rndindex);
+    saveg_write32(totalkills);
+    saveg_write32(totalitems);
+    saveg_write32(totalsecret);
+    saveg_write32(numbraintargets);
+    saveg_write32(braintargeton);
+    saveg_write32(bodyqueslot);
+    saveg_write32(iquehead);
+    saveg_write32(iquetail);
+
+    for (i=0 ; i<ITEMQUESIZE ; i++)
+    {
+        saveg_write_mapthing_t(&itemrespawnque[i]);
+        saveg_write32(itemrespawntime[i]);
+    }
+
+    for (i=0 ; i<MAXBUTTONS ; i++)
+    {
+        saveg_write32(buttonlist[i].line != NULL ?
+                      buttonlist[i].line - lines : -1);
+        saveg_write_enum(buttonlist[i].where);
+        saveg_write32(buttonlist[i].btexture);
+        saveg_write32(buttonlist[i].btimer);
+    }
+
+    P_ArchivePlayers ();
+
+    // the world, without rounding heights and offsets
+    for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
+    {
+        saveg_write32(sec->floorheight);
+        saveg_write32(sec->ceilingheight);
+        saveg_write16(sec->floorpic);
+        saveg_write16(sec->ceilingpic);
+        saveg_write16(sec->lightlevel);
+        saveg_write16(sec->special);
+        saveg_write16(sec->tag);
+        saveg_write32(sec->soundtraversed);
+    }
+
+    for (i=0, li = lines ; i<numlines ; i++,li++)
+    {
+        saveg_write16(li->flags);
+        saveg_write16(li->special);
+        saveg_write16(li->tag);
+
+        for (j=0 ; j<2 ; j++)
+        {
+            if (li->sidenum[j] == -1)
+                continue;
+
+            si = &sides[li->sidenum[j]];
+
+            saveg_write32(si->textureoffset);
+            saveg_write32(si->rowoffset);
+            saveg_write16(si->toptexture);
+            saveg_write16(si->bottomtexture);
+            saveg_write16(si->midtexture);
+        }
+    }
+
+    // all thinkers, in order
+    saveg_write32(numsnapshotmobjs);
+
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+        if (saveg_is_mobj(th))
+        {
+            saveg_write8(th->function.acv == (actionf_v)(-1) ?
+                         sc_removedmobj : sc_mobj);
+            saveg_write_pad();
+            saveg_write_mobj_t((mobj_t *) th);
+            continue;
+        }
+
+        tclass = saveg_special_class(th);
+
+        // savegames lose plats that are in stasis; snapshots can't
+        if (tclass < 0 && th->function.acv == (actionf_v)NULL)
+        {
+            for (i=0 ; i<MAXPLATS ; i++)
+                if (activeplats[i] == (plat_t *) th)
+                    tclass = tc_plat;
+        }
+
+        if (tclass >= 0)
+        {
+            saveg_write8(sc_special);
+            saveg_write_special(th, tclass);
+        }
+    }
+
+    saveg_write8(sc_end);
+
+    // references between mobjs
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+        if (saveg_is_mobj(th))
+        {
+            mobj = (mobj_t *) th;
+            saveg_write_mobjref(mobj->target);
+            saveg_write_mobjref(mobj->tracer);
+        }
+    }
+
+    for (i=0 ; i<MAXPLAYERS ; i++)
+    {
+        saveg_write_mobjref(players[i].mo);
+        saveg_write_mobjref(players[i].attacker);
+    }
+
+    for (i=0 ; i<BODYQUESIZE ; i++)
+        saveg_write_mobjref(bodyque[i]);
+
+    for (i=0 ; i<numbraintargets ; i++)
+        saveg_write_mobjref(braintargets[i]);
+
+    // thing lists, in order
+    for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
+    {
+        saveg_write_mobjref(sec->soundtarget);
+
+        for (mobj = sec->thinglist ; mobj != NULL ; mobj = mobj->snext)
+            saveg_write_mobjref(mobj);
+
+        saveg_write32(-1);
+    }
+
+    for (i=0 ; i<bmapwidth*bmapheight ; i++)
+    {
+        if (blocklinks[i] == NULL)
+            continue;
+
+        saveg_write32(i);
+
+        for (mobj = blocklinks[i] ; mobj != NULL ; mobj = mobj->bnext)
+            saveg_write_mobjref(mobj);
+
+        saveg_write32(-1);
+    }
+
+    saveg_write32(-1);
+
+    Z_Free(snapshotids);
+    snapshotids = NULL;
+}
+
+
+//
+// P_UnArchiveSnapshot
+// Replaces the state of the level, which must be the one the
+// snapshot was taken in, freshly loaded.
+//
+void P_UnArchiveSnapshot (void)
+{
+    thinker_t*		th;
+    thinker_t*		next;
+    mobj_t*		mobj;
+    mobj_t*		prev;
+    sector_t*		sec;
+    line_t*		li;
+    side_t*		si;
+    byte		sclass;
+    int			line;
+    int			i;
+    int			j;
+
+    // throw away everything the level load spawned
+    for (th = thinkercap.next ; th != &thinkercap ; th = next)
+    {
+        next = th->next;
+        Z_SlabFree(th);
+    }
+
+    P_InitThinkers ();
+
+    for (i=0 ; i<MAXCEILINGS ; i++)
+        activeceilings[i] = NULL;
+
+    for (i=0 ; i<MAXPLATS ; i++)
+        activeplats[i] = NULL;
+
+    memset(blocklinks, 0, bmapwidth * bmapheight * sizeof(*blocklinks));
+
+    // level globals
+    prndindex = saveg_read32();
+    rndindex = saveg_read32();
+    totalkills = saveg_read32();
+    totalitems = saveg_read32();
+    totalsecret = saveg_read32();
+    numbraintargets = saveg_read32();
+    braintargeton = saveg_read32();
+    bodyqueslot = saveg_read32();
+    iquehead = saveg_read32();
+    iquetail = saveg_read32();
+
+    for (i=0 ; i<ITEMQUESIZE ; i++)
+    {
+        saveg_read_mapthing_t(&itemrespawnque[i]);
+        itemrespawntime[i] = saveg_read32();
+    }
+
+    for (i=0 ; i<MAXBUTTONS ; i++)
+    {
+        line = saveg_read32();
+        buttonlist[i].line = line >= 0 ? &lines[line] : NULL;
+        buttonlist[i].where = saveg_read_enum();
+        buttonlist[i].btexture = saveg_read32();
+        buttonlist[i].btimer = saveg_read32();
+        buttonlist[i].soundorg = line >= 0 ?
+            &lines[line].frontsector->soundorg : NULL;
+    }
+
+    P_UnArchivePlayers ();
+
+    for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
+    {
+        sec->floorheight = saveg_read32();
+        sec->ceilingheight = saveg_read32();
+        sec->floorpic = saveg_read16();
+        sec->ceilingpic = saveg_read16();
+        sec->lightlevel = saveg_read16();
+        sec->special = saveg_read16();
+        sec->tag = saveg_read16();
+        sec->soundtraversed = saveg_read32();
+        sec->specialdata = NULL;
+        sec->thinglist = NULL;
+    }
+
+    for (i=0, li = lines ; i<numlines ; i++,li++)
+    {
+        li->flags = saveg_read16();
+        li->special = saveg_read16();
+        li->tag = saveg_read16();
+
+        for (j=0 ; j<2 ; j++)
+        {
+            if (li->sidenum[j] == -1)
+                continue;
+
+            si = &sides[li->sidenum[j]];
+
+            si->textureoffset = saveg_read32();
+            si->rowoffset = saveg_read32();
+            si->toptexture = saveg_read16();
+            si->bottomtexture = saveg_read16();
+            si->midtexture = saveg_read16();
+        }
+    }
+
+    // thinkers; mobjs are collected in order to resolve references
+    i = saveg_read32();
+    snapshotmobjs = Z_Malloc((i + 1) * sizeof(mobj_t *), PU_STATIC, NULL);
+    numsnapshotmobjs = 0;
+
+    while ((sclass = saveg_read8()) != sc_end)
+    {
+        switch (sclass)
+        {
+          case sc_mobj:
+          case sc_removedmobj:
+            saveg_read_pad();
+            mobj = Z_SlabAlloc (&mobjslab);
+            saveg_read_mobj_t(mobj);
+
+            mobj->info = &mobjinfo[mobj->type];
+            mobj->subsector = R_PointInSubsector(mobj->x, mobj->y);
+
+            if (sclass == sc_mobj)
+                mobj->thinker.function.acp1 = (actionf_p1)P_MobjThinker;
+            else
+                mobj->thinker.function.acv = (actionf_v)(-1);
+
+            P_AddThinker (&mobj->thinker);
+            snapshotmobjs[numsnapshotmobjs++] = mobj;
+            break;
+
+          case sc_special:
+            saveg_read_special(saveg_read8());
+            break;
+
+          default:
+            I_Error ("P_UnArchiveSnapshot: Unknown class %i", sclass);
+        }
+    }
+
+    for (i=0 ; i<numsnapshotmobjs ; i++)
+    {
+        snapshotmobjs[i]->target = saveg_read_mobjref();
+        snapshotmobjs[i]->tracer = saveg_read_mobjref();
+    }
+
+    for (i=0 ; i<MAXPLAYERS ; i++)
+    {
+        players[i].mo = saveg_read_mobjref();
+        players[i].attacker = saveg_read_mobjref();
+    }
+
+    for (i=0 ; i<BODYQUESIZE ; i++)
+        bodyque[i] = saveg_read_mobjref();
+
+    for (i=0 ; i<numbraintargets ; i++)
+        braintargets[i] = saveg_read_mobjref();
+
+    for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
+    {
+        sec->soundtarget = saveg_read_mobjref();
+        prev = NULL;
+
+        while ((mobj = saveg_read_mobjref()) != NULL)
+        {
+            mobj->sprev = prev;
+            mobj->snext = NULL;
+
+            if (prev != NULL)
+                prev->snext = mobj;
+            else
+                sec->thinglist = mobj;
+
+            prev = mobj;
+        }
+    }
+
+    while ((i = saveg_read32()) >= 0)
+    {
+        prev = NULL;
+
+        while ((mobj = saveg_read_mobjref()) != NULL)
+        {
+            mobj->bprev = prev;
+            mobj->bnext = NULL;
+
+            if (prev != NULL)
+                prev->bnext = mobj;
+            else
+                blocklinks[i] = mobj;
+
+            prev = mobj;
+        }
+    }
+
+    Z_Free(snapshotmobjs);
+    snapshotmobjs = NULL;
+}
@@ -22,6 +22,8 @@
 
 #include <stdio.h>
 
+#include "memio.h"
+
 // maximum size of a savegame description
 
 #define SAVESTRINGSIZE 24
@@ -30,6 +32,10 @@
 
 char *P_TempSaveGameFile(void);
 
+// filename of the game snapshot taken on suspend
+
+char *P_SuspendGameFile(void);
+
 // filename to use for a savegame slot
 
 char *P_SaveGameFile(int slot);
@@ -55,7 +61,14 @@ void P_UnArchiveThinkers (void);
 void P_ArchiveSpecials (void);
 void P_UnArchiveSpecials (void);
 
-extern FILE *save_stream;
+// Exact copies of the level state, for seeking in demos.
+void P_ArchiveSnapshot (void);
+void P_UnArchiveSnapshot (void);
+
+// Savegames are built and parsed in memory; G_DoSaveGame and
+// G_DoLoadGame move them to and from disk in one piece.
+
+extern MEMFILE *save_stream;
 extern boolean savegame_error;
 
 
@@ -20,6 +20,7 @@
 
 
 #include <math.h>
+#include <stdlib.h>
 
 #include "z_zone.h"
 
@@ -31,6 +32,7 @@
 #include "g_game.h"
 
 #include "i_system.h"
+#include "w_prefetch.h"
 #include "w_wad.h"
 
 #include "doomdef.h"
@@ -100,6 +102,9 @@ mobj_t**	blocklinks;
 //
 byte*		rejectmatrix;
 
+// Scratch queue for breadth-first walks of the sector graph.
+sector_t**	sectorqueue;
+
 
 // Maintain single and multi player starting spots.
 #define MAX_DEATHMATCH_STARTS	10
@@ -127,7 +132,7 @@ void P_LoadVertexes (int lump)
     numvertexes = W_LumpLength (lump) / sizeof(mapvertex_t);
 
     // Allocate zone memory for buffer.
-    vertexes = Z_Malloc (numvertexes*sizeof(vertex_t),PU_LEVEL,0);	
+    vertexes = Z_LevelAlloc (numvertexes*sizeof(vertex_t));	
 
     // Load data into cache.
     data = W_CacheLumpNum (lump, PU_STATIC);
@@ -181,7 +186,7 @@ void P_LoadSegs (int lump)
     int                 sidenum;
 	
     numsegs = W_LumpLength (lump) / sizeof(mapseg_t);
-    segs = Z_Malloc (numsegs*sizeof(seg_t),PU_LEVEL,0);	
+    segs = Z_LevelAlloc (numsegs*sizeof(seg_t));	
     memset (segs, 0, numsegs*sizeof(seg_t));
     data = W_CacheLumpNum (lump,PU_STATIC);
 	
@@ -241,7 +246,7 @@ void P_LoadSubsectors (int lump)
     subsector_t*	ss;
 	
     numsubsectors = W_LumpLength (lump) / sizeof(mapsubsector_t);
-    subsectors = Z_Malloc (numsubsectors*sizeof(subsector_t),PU_LEVEL,0);	
+    subsectors = Z_LevelAlloc (numsubsectors*sizeof(subsector_t));	
     data = W_CacheLumpNum (lump,PU_STATIC);
 	
     ms = (mapsubsector_t *)data;
@@ -270,7 +275,7 @@ void P_LoadSectors (int lump)
     sector_t*		ss;
 	
     numsectors = W_LumpLength (lump) / sizeof(mapsector_t);
-    sectors = Z_Malloc (numsectors*sizeof(sector_t),PU_LEVEL,0);	
+    sectors = Z_LevelAlloc (numsectors*sizeof(sector_t));	
     memset (sectors, 0, numsectors*sizeof(sector_t));
     data = W_CacheLumpNum (lump,PU_STATIC);
 	
@@ -305,7 +310,7 @@ void P_LoadNodes (int lump)
     node_t*	no;
 	
     numnodes = W_LumpLength (lump) / sizeof(mapnode_t);
-    nodes = Z_Malloc (numnodes*sizeof(node_t),PU_LEVEL,0);	
+    nodes = Z_LevelAlloc (numnodes*sizeof(node_t));	
     data = W_CacheLumpNum (lump,PU_STATIC);
 	
     mn = (mapnode_t *)data;
@@ -399,7 +404,7 @@ void P_LoadLineDefs (int lump)
     vertex_t*		v2;
 	
     numlines = W_LumpLength (lump) / sizeof(maplinedef_t);
-    lines = Z_Malloc (numlines*sizeof(line_t),PU_LEVEL,0);	
+    lines = Z_LevelAlloc (numlines*sizeof(line_t));	
     memset (lines, 0, numlines*sizeof(line_t));
     data = W_CacheLumpNum (lump,PU_STATIC);
 	
@@ -478,7 +483,7 @@ void P_LoadSideDefs (int lump)
     side_t*		sd;
 	
     numsides = W_LumpLength (lump) / sizeof(mapsidedef_t);
-    sides = Z_Malloc (numsides*sizeof(side_t),PU_LEVEL,0);	
+    sides = Z_LevelAlloc (numsides*sizeof(side_t));	
     memset (sides, 0, numsides*sizeof(side_t));
     data = W_CacheLumpNum (lump,PU_STATIC);
 	
@@ -510,7 +515,7 @@ void P_LoadBlockMap (int lump)
     lumplen = W_LumpLength(lump);
     count = lumplen / 2;
 	
-    blockmaplump = Z_Malloc(lumplen, PU_LEVEL, NULL);
+    blockmaplump = Z_LevelAlloc (lumplen);
     W_ReadLump(lump, blockmaplump);
     blockmap = blockmaplump + 4;
 
@@ -531,7 +536,7 @@ void P_LoadBlockMap (int lump)
     // Clear out mobj chains
 
     count = sizeof(*blocklinks) * bmapwidth * bmapheight;
-    blocklinks = Z_Malloc(count, PU_LEVEL, 0);
+    blocklinks = Z_LevelAlloc (count);
     memset(blocklinks, 0, count);
 }
 
@@ -545,6 +550,9 @@ void P_LoadBlockMap (int lump)
 void P_GroupLines (void)
 {
     line_t**		linebuffer;
+    sectoradj_t*	adjbuffer;
+    sector_t*		other;
+    int			totaladj;
     int			i;
     int			j;
     line_t*		li;
@@ -578,7 +586,7 @@ void P_GroupLines (void)
     }
 
     // build line tables for each sector	
-    linebuffer = Z_Malloc (totallines*sizeof(line_t *), PU_LEVEL, 0);
+    linebuffer = Z_LevelAlloc (totallines*sizeof(line_t *));
 
     for (i=0; i<numsectors; ++i)
     {
@@ -616,6 +624,46 @@ void P_GroupLines (void)
         }
     }
     
+    // Build the sector adjacency lists from the line lists, so
+    // noise alerts and the surrounding sector searches don't
+    // have to pick the two-sided lines out every time.
+
+    totaladj = 0;
+    sector = sectors;
+    for (i=0 ; i<numsectors ; i++, sector++)
+    {
+	for (j=0 ; j<sector->linecount ; j++)
+	{
+	    if (getNextSector (sector->lines[j], sector) != NULL)
+		totaladj++;
+	}
+    }
+
+    adjbuffer = Z_LevelAlloc (totaladj*sizeof(sectoradj_t));
+
+    sector = sectors;
+    for (i=0 ; i<numsectors ; i++, sector++)
+    {
+	sector->adj = adjbuffer;
+	sector->adjcount = 0;
+
+	for (j=0 ; j<sector->linecount ; j++)
+	{
+	    li = sector->lines[j];
+	    other = getNextSector (li, sector);
+
+	    if (other == NULL)
+		continue;
+
+	    adjbuffer->sector = other;
+	    adjbuffer->line = li;
+	    adjbuffer++;
+	    sector->adjcount++;
+	}
+    }
+
+    sectorqueue = Z_LevelAlloc (numsectors*sizeof(sector_t *));
+
     // Generate bounding boxes for sectors
 	
     sector = sectors;
@@ -789,6 +837,9 @@ P_SetupLevel
     }
 
     lumpnum = W_GetNumForName (lumpname);
+
+    // read ahead whatever this level loaded the last time
+    W_BeginLoadPhase (lumpname);
 	
     leveltime = 0;
 	
@@ -835,6 +886,8 @@ P_SetupLevel
     if (precache)
 	R_PrecacheLevel ();
 
+    W_EndLoadPhase ();
+
     //printf ("free memory: 0x%x\n", Z_FreeMemory());
 
 }
@@ -846,9 +899,23 @@ P_SetupLevel
 //
 void P_Init (void)
 {
+    int		p;
+
     P_InitSwitchList ();
     P_InitPicAnims ();
     R_InitSprites (sprnames);
+
+    //!
+    // @arg <n>
+    //
+    // Work out the sight checks monsters are about to make on n
+    // threads at the start of each tic.
+    //
+
+    p = M_CheckParmWithArgs ("-sightthreads", 1);
+
+    if (p)
+	P_SetSightThreads (atoi (myargv[p+1]));
 }
 
 
@@ -18,7 +18,10 @@
 
 
 
+#include <string.h>
+
 #include "doomdef.h"
+#include "doomstat.h"
 
 #include "i_system.h"
 #include "p_local.h"
@@ -29,16 +32,30 @@
 //
 // P_CheckSight
 //
-fixed_t		sightzstart;		// eye z of looker
-fixed_t		topslope;
-fixed_t		bottomslope;		// slopes to top and bottom of target
+typedef struct
+{
+    fixed_t	sightzstart;		// eye z of looker
+    fixed_t	topslope;
+    fixed_t	bottomslope;		// slopes to top and bottom of target
+
+    divline_t	strace;			// from t1 to t2
+    fixed_t	t2x;
+    fixed_t	t2y;
 
-divline_t	strace;			// from t1 to t2
-fixed_t		t2x;
-fixed_t		t2y;
+    // Skip lines already checked from their other side, using
+    // validcount.  Off for the pre-pass workers, which can't touch
+    // shared state; checking a line twice gives the same answer.
+    boolean	marklines;
+} sighttrace_t;
 
 int		sightcounts[2];
 
+// Bumped whenever a floor or ceiling moves, which can
+// change what can be seen from where.
+int		sectorheightgen;
+
+int		sightthreads;		// 0 = no pre-pass
+
 
 //
 // P_DivlineSide
@@ -125,7 +142,7 @@ P_InterceptVector2
 // Returns true
 //  if strace crosses the given subsector successfully.
 //
-boolean P_CrossSubsector (int num)
+static boolean P_CrossSubsector (sighttrace_t* st, int num)
 {
     seg_t*		seg;
     line_t*		line;
@@ -161,15 +178,18 @@ boolean P_CrossSubsector (int num)
 	line = seg->linedef;
 
 	// allready checked other side?
-	if (line->validcount == validcount)
-	    continue;
+	if (st->marklines)
+	{
+	    if (line->validcount == validcount)
+		continue;
 	
-	line->validcount = validcount;
+	    line->validcount = validcount;
+	}
 
 	v1 = line->v1;
 	v2 = line->v2;
-	s1 = P_DivlineSide (v1->x,v1->y, &strace);
-	s2 = P_DivlineSide (v2->x, v2->y, &strace);
+	s1 = P_DivlineSide (v1->x,v1->y, &st->strace);
+	s2 = P_DivlineSide (v2->x, v2->y, &st->strace);
 
 	// line isn't crossed?
 	if (s1 == s2)
@@ -179,8 +199,8 @@ boolean P_CrossSubsector (int num)
 	divl.y = v1->y;
 	divl.dx = v2->x - v1->x;
 	divl.dy = v2->y - v1->y;
-	s1 = P_DivlineSide (strace.x, strace.y, &divl);
-	s2 = P_DivlineSide (t2x, t2y, &divl);
+	s1 = P_DivlineSide (st->strace.x, st->strace.y, &divl);
+	s2 = P_DivlineSide (st->t2x, st->t2y, &divl);
 
 	// line isn't crossed?
 	if (s1 == s2)
@@ -225,23 +245,23 @@ boolean P_CrossSubsector (int num)
 	if (openbottom >= opentop)	
 	    return false;		// stop
 	
-	frac = P_InterceptVector2 (&strace, &divl);
+	frac = P_InterceptVector2 (&st->strace, &divl);
 		
 	if (front->floorheight != back->floorheight)
 	{
-	    slope = FixedDiv (openbottom - sightzstart , frac);
-	    if (slope > bottomslope)
-		bottomslope = slope;
+	    slope = FixedDiv (openbottom - st->sightzstart , frac);
+	    if (slope > st->bottomslope)
+		st->bottomslope = slope;
 	}
 		
 	if (front->ceilingheight != back->ceilingheight)
 	{
-	    slope = FixedDiv (opentop - sightzstart , frac);
-	    if (slope < topslope)
-		topslope = slope;
+	    slope = FixedDiv (opentop - st->sightzstart , frac);
+	    if (slope < st->topslope)
+		st->topslope = slope;
 	}
 		
-	if (topslope <= bottomslope)
+	if (st->topslope <= st->bottomslope)
 	    return false;		// stop				
     }
     // passed the subsector ok
@@ -255,7 +275,7 @@ boolean P_CrossSubsector (int num)
 // Returns true
 //  if strace crosses the given node successfully.
 //
-boolean P_CrossBSPNode (int bspnum)
+static boolean P_CrossBSPNode (sighttrace_t* st, int bspnum)
 {
     node_t*	bsp;
     int		side;
@@ -263,44 +283,40 @@ boolean P_CrossBSPNode (int bspnum)
     if (bspnum & NF_SUBSECTOR)
     {
 	if (bspnum == -1)
-	    return P_CrossSubsector (0);
+	    return P_CrossSubsector (st, 0);
 	else
-	    return P_CrossSubsector (bspnum&(~NF_SUBSECTOR));
+	    return P_CrossSubsector (st, bspnum&(~NF_SUBSECTOR));
     }
 		
     bsp = &nodes[bspnum];
     
     // decide which side the start point is on
-    side = P_DivlineSide (strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide (st->strace.x, st->strace.y, (divline_t *)bsp);
     if (side == 2)
 	side = 0;	// an "on" should cross both sides
 
     // cross the starting side
-    if (!P_CrossBSPNode (bsp->children[side]) )
+    if (!P_CrossBSPNode (st, bsp->children[side]) )
 	return false;
 	
     // the partition plane is crossed here
-    if (side == P_DivlineSide (t2x, t2y,(divline_t *)bsp))
+    if (side == P_DivlineSide (st->t2x, st->t2y,(divline_t *)bsp))
     {
 	// the line doesn't touch the other side
 	return true;
     }
     
     // cross the ending side		
-    return P_CrossBSPNode (bsp->children[side^1]);
+    return P_CrossBSPNode (st, bsp->children[side^1]);
 }
 
 
 //
-// P_CheckSight
-// Returns true
-//  if a straight line between t1 and t2 is unobstructed.
-// Uses REJECT.
+// P_Rejected
+// Returns true if the REJECT table says t1 and t2
+//  can't possibly see each other.
 //
-boolean
-P_CheckSight
-( mobj_t*	t1,
-  mobj_t*	t2 )
+static boolean P_Rejected (mobj_t* t1, mobj_t* t2)
 {
     int		s1;
     int		s2;
@@ -308,8 +324,6 @@ P_CheckSight
     int		bytenum;
     int		bitnum;
     
-    // First check for trivial rejection.
-
     // Determine subsector entries in REJECT table.
     s1 = (t1->subsector->sector - sectors);
     s2 = (t2->subsector->sector - sectors);
@@ -317,8 +331,298 @@ P_CheckSight
     bytenum = pnum>>3;
     bitnum = 1 << (pnum&7);
 
-    // Check in REJECT table.
-    if (rejectmatrix[bytenum]&bitnum)
+    return (rejectmatrix[bytenum]&bitnum) != 0;
+}
+
+
+//
+// P_TraceSight
+// Looks from the eyes of t1 to any part of t2.
+//
+static boolean
+P_TraceSight
+( sighttrace_t*	st,
+  mobj_t*	t1,
+  mobj_t*	t2 )
+{
+    st->sightzstart = t1->z + t1->height - (t1->height>>2);
+    st->topslope = (t2->z+t2->height) - st->sightzstart;
+    st->bottomslope = (t2->z) - st->sightzstart;
+	
+    st->strace.x = t1->x;
+    st->strace.y = t1->y;
+    st->t2x = t2->x;
+    st->t2y = t2->y;
+    st->strace.dx = t2->x - t1->x;
+    st->strace.dy = t2->y - t1->y;
+
+    // the head node is the last node output
+    return P_CrossBSPNode (st, numnodes-1);	
+}
+
+
+//
+// SIGHT PRE-PASS
+// With -sightthreads, the sight checks that monsters are about to
+// make this tic are run across worker threads before the thinkers,
+// and P_CheckSight hands the answers back as the thinkers ask for
+// them.  An answer is only used while neither mobj nor any floor or
+// ceiling has moved since, so it is always what the check itself
+// would have said, and the thinkers still run, and call P_Random,
+// in their usual order.
+//
+#define MAXSIGHTQUERIES		1024
+#define SIGHTHASHSIZE		2048	// power of two
+#define MAXSIGHTTHREADS		8
+
+typedef struct
+{
+    mobj_t*	t1;
+    mobj_t*	t2;
+
+    // where they were when the answer was worked out
+    fixed_t	x1;
+    fixed_t	y1;
+    fixed_t	z1;
+    fixed_t	height1;
+    fixed_t	x2;
+    fixed_t	y2;
+    fixed_t	z2;
+    fixed_t	height2;
+
+    boolean	result;
+} sightquery_t;
+
+static sightquery_t	sightqueries[MAXSIGHTQUERIES];
+static int		numsightqueries;
+static short		sighthash[SIGHTHASHSIZE];	// -1 = empty
+static int		sightquerygen;
+static int		sightslices[MAXSIGHTTHREADS];
+static void*		sightargs[MAXSIGHTTHREADS];
+static i_pool_t*	sightpool;
+
+void A_Look (mobj_t* actor);
+void A_Chase (mobj_t* actor);
+
+static unsigned int P_SightHash (mobj_t* t1, mobj_t* t2)
+{
+    unsigned int	h;
+
+    h = (unsigned int) ((size_t) t1 >> 4) * 31
+      + (unsigned int) ((size_t) t2 >> 4);
+
+    return h & (SIGHTHASHSIZE-1);
+}
+
+//
+// P_FindSightQuery
+// Returns the pre-pass answer for t1 looking at t2,
+//  or NULL if there isn't one that still holds.
+//
+static sightquery_t*
+P_FindSightQuery
+( mobj_t*	t1,
+  mobj_t*	t2 )
+{
+    unsigned int	h;
+    sightquery_t*	q;
+
+    if (numsightqueries == 0 || sightquerygen != sectorheightgen)
+	return NULL;
+
+    for (h = P_SightHash (t1, t2) ;
+	 sighthash[h] != -1 ;
+	 h = (h+1) & (SIGHTHASHSIZE-1))
+    {
+	q = &sightqueries[sighthash[h]];
+
+	if (q->t1 != t1 || q->t2 != t2)
+	    continue;
+
+	if (q->x1 != t1->x || q->y1 != t1->y
+	 || q->z1 != t1->z || q->height1 != t1->height
+	 || q->x2 != t2->x || q->y2 != t2->y
+	 || q->z2 != t2->z || q->height2 != t2->height)
+	{
+	    return NULL;
+	}
+
+	return q;
+    }
+
+    return NULL;
+}
+
+static void
+P_AddSightQuery
+( mobj_t*	t1,
+  mobj_t*	t2 )
+{
+    unsigned int	h;
+    sightquery_t*	q;
+
+    // only look at things that are still in the world
+    if (t2 == NULL
+     || t2->thinker.function.acp1 != (actionf_p1) P_MobjThinker
+     || numsightqueries == MAXSIGHTQUERIES)
+    {
+	return;
+    }
+
+    for (h = P_SightHash (t1, t2) ;
+	 sighthash[h] != -1 ;
+	 h = (h+1) & (SIGHTHASHSIZE-1))
+    {
+	q = &sightqueries[sighthash[h]];
+
+	if (q->t1 == t1 && q->t2 == t2)
+	    return;
+    }
+
+    q = &sightqueries[numsightqueries];
+    q->t1 = t1;
+    q->t2 = t2;
+    q->x1 = t1->x;
+    q->y1 = t1->y;
+    q->z1 = t1->z;
+    q->height1 = t1->height;
+    q->x2 = t2->x;
+    q->y2 = t2->y;
+    q->z2 = t2->z;
+    q->height2 = t2->height;
+
+    sighthash[h] = numsightqueries++;
+}
+
+//
+// P_RunSightQueries
+// Worker: answers every sightthreads'th query from the given one.
+//
+static void P_RunSightQueries (void* arg)
+{
+    sighttrace_t	st;
+    sightquery_t*	q;
+    int			i;
+
+    st.marklines = false;
+
+    for (i = *(int *) arg ; i < numsightqueries ; i += sightthreads)
+    {
+	q = &sightqueries[i];
+	q->result = !P_Rejected (q->t1, q->t2)
+		 && P_TraceSight (&st, q->t1, q->t2);
+    }
+}
+
+//
+// P_RunSightPrepass
+// Called before the thinkers run.  Works out the sight checks of
+//  every monster whose next state, entered this tic, looks or chases.
+//
+void P_RunSightPrepass (void)
+{
+    thinker_t*		th;
+    mobj_t*		mo;
+    state_t*		next;
+    int			i;
+
+    numsightqueries = 0;
+
+    if (sightthreads <= 0)
+	return;
+
+    memset (sighthash, 0xff, sizeof(sighthash));
+    sightquerygen = sectorheightgen;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th = th->next)
+    {
+	if (th->function.acp1 != (actionf_p1) P_MobjThinker)
+	    continue;
+
+	mo = (mobj_t *) th;
+
+	if (mo->tics != 1)
+	    continue;
+
+	next = &states[mo->state->nextstate];
+
+	if (next->action.acp1 == (actionf_p1) A_Look)
+	{
+	    if (mo->flags & MF_AMBUSH)
+		P_AddSightQuery (mo, mo->subsector->sector->soundtarget);
+	}
+	else if (next->action.acp1 == (actionf_p1) A_Chase)
+	{
+	    P_AddSightQuery (mo, mo->target);
+	}
+	else
+	{
+	    continue;
+	}
+
+	for (i=0 ; i<MAXPLAYERS ; i++)
+	{
+	    if (playeringame[i] && players[i].health > 0)
+		P_AddSightQuery (mo, players[i].mo);
+	}
+    }
+
+    if (numsightqueries == 0)
+	return;
+
+    // The workers are started on first use, not when the count is
+    // set, so that a process forked after startup gets its own.
+    if (sightpool == NULL)
+    {
+	for (i=0 ; i<MAXSIGHTTHREADS ; i++)
+	{
+	    sightslices[i] = i;
+	    sightargs[i] = &sightslices[i];
+	}
+
+	sightpool = I_CreatePool (sightthreads - 1);
+    }
+
+    I_RunPool (sightpool, P_RunSightQueries, sightargs, sightthreads);
+}
+
+//
+// P_EndSightPrepass
+// Called after the thinkers, the answers are only good for this tic.
+//
+void P_EndSightPrepass (void)
+{
+    numsightqueries = 0;
+}
+
+//
+// P_SetSightThreads
+//
+void P_SetSightThreads (int threads)
+{
+    if (threads > MAXSIGHTTHREADS)
+	threads = MAXSIGHTTHREADS;
+
+    sightthreads = threads;
+}
+
+
+//
+// P_CheckSight
+// Returns true
+//  if a straight line between t1 and t2 is unobstructed.
+// Uses REJECT.
+//
+boolean
+P_CheckSight
+( mobj_t*	t1,
+  mobj_t*	t2 )
+{
+    sighttrace_t	st;
+    sightquery_t*	q;
+
+    // First check for trivial rejection.
+    if (P_Rejected (t1, t2))
     {
 	sightcounts[0]++;
 
@@ -330,21 +634,14 @@ P_CheckSight
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
 
-    validcount++;
-	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
-	
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
+    q = P_FindSightQuery (t1, t2);
 
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
-}
+    if (q != NULL)
+	return q->result;
+
+    validcount++;
 
+    st.marklines = true;
 
+    return P_TraceSight (&st, t1, t2);
+}
@@ -269,17 +269,12 @@ getNextSector
 fixed_t	P_FindLowestFloorSurrounding(sector_t* sec)
 {
     int			i;
-    line_t*		check;
     sector_t*		other;
     fixed_t		floor = sec->floorheight;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->adjcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-
-	if (!other)
-	    continue;
+	other = sec->adj[i].sector;
 	
 	if (other->floorheight < floor)
 	    floor = other->floorheight;
@@ -296,17 +291,12 @@ fixed_t	P_FindLowestFloorSurrounding(sector_t* sec)
 fixed_t	P_FindHighestFloorSurrounding(sector_t *sec)
 {
     int			i;
-    line_t*		check;
     sector_t*		other;
     fixed_t		floor = -500*FRACUNIT;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->adjcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-	
-	if (!other)
-	    continue;
+	other = sec->adj[i].sector;
 	
 	if (other->floorheight > floor)
 	    floor = other->floorheight;
@@ -334,19 +324,14 @@ P_FindNextHighestFloor
     int         i;
     int         h;
     int         min;
-    line_t*     check;
     sector_t*   other;
     fixed_t     height = currentheight;
     fixed_t     heightlist[MAX_ADJOINING_SECTORS + 2];
 
-    for (i=0, h=0; i < sec->linecount; i++)
+    for (i=0, h=0; i < sec->adjcount; i++)
     {
-        check = sec->lines[i];
-        other = getNextSector(check,sec);
+        other = sec->adj[i].sector;
 
-        if (!other)
-            continue;
-        
         if (other->floorheight > height)
         {
             // Emulation of memory (stack) overflow
@@ -392,17 +377,12 @@ fixed_t
 P_FindLowestCeilingSurrounding(sector_t* sec)
 {
     int			i;
-    line_t*		check;
     sector_t*		other;
     fixed_t		height = INT_MAX;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->adjcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-
-	if (!other)
-	    continue;
+	other = sec->adj[i].sector;
 
 	if (other->ceilingheight < height)
 	    height = other->ceilingheight;
@@ -417,17 +397,12 @@ P_FindLowestCeilingSurrounding(sector_t* sec)
 fixed_t	P_FindHighestCeilingSurrounding(sector_t* sec)
 {
     int		i;
-    line_t*	check;
     sector_t*	other;
     fixed_t	height = 0;
 	
-    for (i=0 ;i < sec->linecount ; i++)
+    for (i=0 ;i < sec->adjcount ; i++)
     {
-	check = sec->lines[i];
-	other = getNextSector(check,sec);
-
-	if (!other)
-	    continue;
+	other = sec->adj[i].sector;
 
 	if (other->ceilingheight > height)
 	    height = other->ceilingheight;
@@ -467,17 +442,12 @@ P_FindMinSurroundingLight
 {
     int		i;
     int		min;
-    line_t*	line;
     sector_t*	check;
 	
     min = max;
-    for (i=0 ; i < sector->linecount ; i++)
+    for (i=0 ; i < sector->adjcount ; i++)
     {
-	line = sector->lines[i];
-	check = getNextSector(line,sector);
-
-	if (!check)
-	    continue;
+	check = sector->adj[i].sector;
 
 	if (check->lightlevel < min)
 	    min = check->lightlevel;
@@ -1325,7 +1295,7 @@ int EV_DoDonut(line_t*	line)
             }
 
 	    //	Spawn rising slime
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	    floor = Z_SlabAlloc (&floorslab);
 	    P_AddThinker (&floor->thinker);
 	    s2->specialdata = floor;
 	    floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -1339,7 +1309,7 @@ int EV_DoDonut(line_t*	line)
 	    floor->floordestheight = s3_floorheight;
 	    
 	    //	Spawn lowering donut-hole
-	    floor = Z_Malloc (sizeof(*floor), PU_LEVSPEC, 0);
+	    floor = Z_SlabAlloc (&floorslab);
 	    P_AddThinker (&floor->thinker);
 	    s1->specialdata = floor;
 	    floor->thinker.function.acp1 = (actionf_p1) T_MoveFloor;
@@ -28,8 +28,8 @@ int	leveltime;
 
 //
 // THINKERS
-// All thinkers should be allocated by Z_Malloc
-// so they can be operated on uniformly.
+// All thinkers should be allocated from one of the zone slabs
+// below so they can be operated on uniformly.
 // The actual structures will vary in size,
 // but the first element must be thinker_t.
 //
@@ -39,6 +39,17 @@ int	leveltime;
 // Both the head and tail of the thinker list.
 thinker_t	thinkercap;
 
+// One slab per thinker type.
+zslab_t		mobjslab = Z_SLAB(mobj_t, PU_LEVEL);
+zslab_t		ceilingslab = Z_SLAB(ceiling_t, PU_LEVSPEC);
+zslab_t		doorslab = Z_SLAB(vldoor_t, PU_LEVSPEC);
+zslab_t		floorslab = Z_SLAB(floormove_t, PU_LEVSPEC);
+zslab_t		platslab = Z_SLAB(plat_t, PU_LEVSPEC);
+zslab_t		fireflickerslab = Z_SLAB(fireflicker_t, PU_LEVSPEC);
+zslab_t		lightflashslab = Z_SLAB(lightflash_t, PU_LEVSPEC);
+zslab_t		strobeslab = Z_SLAB(strobe_t, PU_LEVSPEC);
+zslab_t		glowslab = Z_SLAB(glow_t, PU_LEVSPEC);
+
 
 //
 // P_InitThinkers
@@ -94,6 +105,7 @@ void P_AllocateThinker (thinker_t*	thinker)
 void P_RunThinkers (void)
 {
     thinker_t*	currentthinker;
+    thinker_t*	next;
 
     currentthinker = thinkercap.next;
     while (currentthinker != &thinkercap)
@@ -101,16 +113,19 @@ void P_RunThinkers (void)
 	if ( currentthinker->function.acv == (actionf_v)(-1) )
 	{
 	    // time to remove it
+	    // (get link before freeing, the slab reuses it)
+	    next = currentthinker->next;
 	    currentthinker->next->prev = currentthinker->prev;
 	    currentthinker->prev->next = currentthinker->next;
-	    Z_Free (currentthinker);
+	    Z_SlabFree (currentthinker);
+	    currentthinker = next;
 	}
 	else
 	{
 	    if (currentthinker->function.acp1)
 		currentthinker->function.acp1 (currentthinker);
+	    currentthinker = currentthinker->next;
 	}
-	currentthinker = currentthinker->next;
     }
 }
 
@@ -142,7 +157,9 @@ void P_Ticker (void)
 	if (playeringame[i])
 	    P_PlayerThink (&players[i]);
 			
+    P_RunSightPrepass ();
     P_RunThinkers ();
+    P_EndSightPrepass ();
     P_UpdateSpecials ();
     P_RespawnSpecials ();
 
@@ -325,7 +325,8 @@ void R_GenerateLookup (int texnum)
 	 i<texture->patchcount;
 	 i++, patch++)
     {
-	realpatch = W_CacheLumpNum (patch->patch, PU_CACHE);
+	// held while used, as the sound thread may purge the cache
+	realpatch = W_CacheLumpNum (patch->patch, PU_STATIC);
 	x1 = patch->originx;
 	x2 = x1 + SHORT(realpatch->width);
 	
@@ -342,6 +343,8 @@ void R_GenerateLookup (int texnum)
 	    collump[x] = patch->patch;
 	    colofs[x] = LONG(realpatch->columnofs[x-x1])+3;
 	}
+
+	W_ReleaseLumpNum (patch->patch);
     }
 	
     for (x=0 ; x<texture->width ; x++)
@@ -670,10 +673,12 @@ void R_InitSpriteLumps (void)
 	if (!(i&63))
 	    printf (".");
 
-	patch = W_CacheLumpNum (firstspritelump+i, PU_CACHE);
+	// held while used, as the sound thread may purge the cache
+	patch = W_CacheLumpNum (firstspritelump+i, PU_STATIC);
 	spritewidth[i] = SHORT(patch->width)<<FRACBITS;
 	spriteoffset[i] = SHORT(patch->leftoffset)<<FRACBITS;
 	spritetopoffset[i] = SHORT(patch->topoffset)<<FRACBITS;
+	W_ReleaseLumpNum (firstspritelump+i);
     }
 }
 
@@ -127,9 +127,20 @@ typedef	struct
 
     int			linecount;
     struct line_s**	lines;	// [linecount] size
+
+    // two-sided lines out of the sector, in lines[] order,
+    // with the sector on the other side of each
+    int			adjcount;
+    struct sectoradj_s*	adj;	// [adjcount] size
     
 } sector_t;
 
+typedef struct sectoradj_s
+{
+    sector_t*		sector;
+    struct line_s*	line;
+} sectoradj_t;
+
 
 
 
@@ -89,6 +89,10 @@ fixed_t			dc_texturemid;
 // first pixel in a column (possibly virtual) 
 byte*			dc_source;		
 
+// height of the texture the column is taken from,
+//  for the wall drawers picked by R_WallColumnFunc
+int			dc_texheight;
+
 // just for profiling 
 int			dccount;
 
@@ -98,156 +102,128 @@ int			dccount;
 //  will always have constant z depth.
 // Thus a special case loop for very fast rendering can
 //  be used. It has also been used with Wolfenstein 3D.
-// 
-void R_DrawColumn (void) 
-{ 
-    int			count; 
-    byte*		dest; 
-    fixed_t		frac;
-    fixed_t		fracstep;	 
- 
-    count = dc_yh - dc_yl; 
-
-    // Zero length, column does not exceed a pixel.
-    if (count < 0) 
-	return; 
-				 
-#ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
-	|| dc_yl < 0
-	|| dc_yh >= SCREENHEIGHT) 
-	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x); 
-#endif 
-
-    // Framebuffer destination address.
-    // Use ylookup LUT to avoid multiply with ScreenWidth.
-    // Use columnofs LUT for subwindows? 
-    dest = ylookup[dc_yl] + columnofs[dc_x];  
-
-    // Determine scaling,
-    //  which is the only mapping to be done.
-    fracstep = dc_iscale; 
-    frac = dc_texturemid + (dc_yl-centery)*fracstep; 
-
-    // Inner loop that does the actual texture mapping,
-    //  e.g. a DDA-lile scaling.
-    // This is as fast as it gets.
-    do 
-    {
-	// Re-map color indices from wall texture column
-	//  using a lighting/special effects LUT.
-	*dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
-	
-	dest += SCREENWIDTH; 
-	frac += fracstep;
-	
-    } while (count--); 
-} 
-
-
-
-// UNUSED.
-// Loop unrolled.
-#if 0
-void R_DrawColumn (void) 
-{ 
-    int			count; 
-    byte*		source;
-    byte*		dest;
-    byte*		colormap;
-    
-    unsigned		frac;
-    unsigned		fracstep;
-    unsigned		fracstep2;
-    unsigned		fracstep3;
-    unsigned		fracstep4;	 
- 
-    count = dc_yh - dc_yl + 1; 
-
-    source = dc_source;
-    colormap = dc_colormap;		 
-    dest = ylookup[dc_yl] + columnofs[dc_x];  
-	 
-    fracstep = dc_iscale<<9; 
-    frac = (dc_texturemid + (dc_yl-centery)*dc_iscale)<<9; 
- 
-    fracstep2 = fracstep+fracstep;
-    fracstep3 = fracstep2+fracstep;
-    fracstep4 = fracstep3+fracstep;
-	
-    while (count >= 8) 
-    { 
-	dest[0] = colormap[source[frac>>25]]; 
-	dest[SCREENWIDTH] = colormap[source[(frac+fracstep)>>25]]; 
-	dest[SCREENWIDTH*2] = colormap[source[(frac+fracstep2)>>25]]; 
-	dest[SCREENWIDTH*3] = colormap[source[(frac+fracstep3)>>25]];
-	
-	frac += fracstep4; 
-
-	dest[SCREENWIDTH*4] = colormap[source[frac>>25]]; 
-	dest[SCREENWIDTH*5] = colormap[source[(frac+fracstep)>>25]]; 
-	dest[SCREENWIDTH*6] = colormap[source[(frac+fracstep2)>>25]]; 
-	dest[SCREENWIDTH*7] = colormap[source[(frac+fracstep3)>>25]]; 
-
-	frac += fracstep4; 
-	dest += SCREENWIDTH*8; 
-	count -= 8;
-    } 
-	
-    while (count > 0)
-    { 
-	*dest = colormap[source[frac>>25]]; 
-	dest += SCREENWIDTH; 
-	frac += fracstep; 
-	count--;
-    } 
-}
+//
+// All the plain column drawers are generated from one template.
+// They differ only in how the texel row is derived from frac
+//  (setup/texel/advance) and in whether pixels are doubled for
+//  low detail. The loop is unrolled by four; short columns go
+//  straight to the tail loop.
+//
+#ifdef RANGECHECK
+#define COLUMN_RANGECHECK(name)						\
+    if ((unsigned)dc_x >= SCREENWIDTH					\
+	|| dc_yl < 0							\
+	|| dc_yh >= SCREENHEIGHT)					\
+	I_Error (name ": %i to %i at %i", dc_yl, dc_yh, dc_x);
+#else
+#define COLUMN_RANGECHECK(name)
 #endif
 
+#define COLUMN_PIXEL(ofs, lowdetail, texel)				\
+    pixel = colormap[source[texel]];					\
+    dest[ofs] = pixel;							\
+    if (lowdetail)							\
+	dest[(ofs)+1] = pixel;
+
+#define DEFINE_COLUMN_DRAWER(name, lowdetail, setup, texel, advance)	\
+void name (void)							\
+{									\
+    int			count;						\
+    byte*		dest;						\
+    byte*		source;						\
+    byte*		colormap;					\
+    fixed_t		frac;						\
+    fixed_t		fracstep;					\
+    byte		pixel;						\
+									\
+    count = dc_yh - dc_yl + 1;						\
+									\
+    /* Zero length, column does not exceed a pixel. */			\
+    if (count <= 0)							\
+	return;								\
+									\
+    COLUMN_RANGECHECK(#name)						\
+									\
+    /* Blocky mode, need to multiply by 2. */				\
+    dest = ylookup[dc_yl] + columnofs[lowdetail ? dc_x << 1 : dc_x];	\
+    source = dc_source;							\
+    colormap = dc_colormap;						\
+									\
+    /* Determine scaling, */						\
+    /*  which is the only mapping to be done. */			\
+    fracstep = dc_iscale;						\
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;			\
+									\
+    setup								\
+									\
+    while (count >= 4)							\
+    {									\
+	COLUMN_PIXEL(0, lowdetail, texel) advance			\
+	COLUMN_PIXEL(SCREENWIDTH, lowdetail, texel) advance		\
+	COLUMN_PIXEL(SCREENWIDTH*2, lowdetail, texel) advance		\
+	COLUMN_PIXEL(SCREENWIDTH*3, lowdetail, texel) advance		\
+	dest += SCREENWIDTH*4;						\
+	count -= 4;							\
+    }									\
+									\
+    while (count-- > 0)							\
+    {									\
+	COLUMN_PIXEL(0, lowdetail, texel) advance			\
+	dest += SCREENWIDTH;						\
+    }									\
+}
 
-void R_DrawColumnLow (void) 
-{ 
-    int			count; 
-    byte*		dest; 
-    byte*		dest2;
-    fixed_t		frac;
-    fixed_t		fracstep;	 
-    int                 x;
- 
-    count = dc_yh - dc_yl; 
-
-    // Zero length.
-    if (count < 0) 
-	return; 
-				 
-#ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
-	|| dc_yl < 0
-	|| dc_yh >= SCREENHEIGHT)
-    {
-	
-	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
-    }
-    //	dccount++; 
-#endif 
-    // Blocky mode, need to multiply by 2.
-    x = dc_x << 1;
-    
-    dest = ylookup[dc_yl] + columnofs[x];
-    dest2 = ylookup[dc_yl] + columnofs[x+1];
-    
-    fracstep = dc_iscale; 
-    frac = dc_texturemid + (dc_yl-centery)*fracstep;
-    
-    do 
-    {
-	// Hack. Does not work corretly.
-	*dest2 = *dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
-	frac += fracstep; 
-
-    } while (count--);
+// 128 high, as the original engine assumed for everything.
+// Sprites, masked textures and the sky go through these.
+#define COLUMN_TEXEL_128	((frac>>FRACBITS)&127)
+
+// Power of two heights wrap with a mask.
+#define COLUMN_SETUP_POW2	int mask = dc_texheight - 1;
+#define COLUMN_TEXEL_POW2	((frac>>FRACBITS)&mask)
+
+// Other heights keep frac within [0, height) so the texture tiles
+//  instead of running off the end of the column.
+#define COLUMN_SETUP_NONPOW2						\
+    fixed_t heightfrac = dc_texheight << FRACBITS;			\
+    fracstep = (unsigned) fracstep % (unsigned) heightfrac;		\
+    frac %= heightfrac;							\
+    if (frac < 0)							\
+	frac += heightfrac;
+#define COLUMN_TEXEL_NONPOW2	(frac>>FRACBITS)
+#define COLUMN_ADVANCE_NONPOW2						\
+    if ((frac += fracstep) >= heightfrac)				\
+	frac -= heightfrac;
+
+#define COLUMN_ADVANCE		frac += fracstep;
+
+DEFINE_COLUMN_DRAWER(R_DrawColumn, false,
+		     , COLUMN_TEXEL_128, COLUMN_ADVANCE)
+DEFINE_COLUMN_DRAWER(R_DrawColumnLow, true,
+		     , COLUMN_TEXEL_128, COLUMN_ADVANCE)
+DEFINE_COLUMN_DRAWER(R_DrawColumnPow2, false,
+		     COLUMN_SETUP_POW2, COLUMN_TEXEL_POW2, COLUMN_ADVANCE)
+DEFINE_COLUMN_DRAWER(R_DrawColumnPow2Low, true,
+		     COLUMN_SETUP_POW2, COLUMN_TEXEL_POW2, COLUMN_ADVANCE)
+DEFINE_COLUMN_DRAWER(R_DrawColumnNonPow2, false,
+		     COLUMN_SETUP_NONPOW2, COLUMN_TEXEL_NONPOW2,
+		     COLUMN_ADVANCE_NONPOW2)
+DEFINE_COLUMN_DRAWER(R_DrawColumnNonPow2Low, true,
+		     COLUMN_SETUP_NONPOW2, COLUMN_TEXEL_NONPOW2,
+		     COLUMN_ADVANCE_NONPOW2)
+
+
+//
+// R_WallColumnFunc
+// Picks the column drawer for a wall texture of the given height
+//  in texels, for the current detail level. The caller sets
+//  dc_texheight to the same height before drawing.
+//
+colfunc_t R_WallColumnFunc (int height)
+{
+    if ((height & (height - 1)) == 0)
+	return detailshift ? R_DrawColumnPow2Low : R_DrawColumnPow2;
+    else
+	return detailshift ? R_DrawColumnNonPow2Low : R_DrawColumnNonPow2;
 }
 
 
@@ -640,77 +616,67 @@ void R_DrawSpan (void)
 
 
 
-// UNUSED.
-// Loop unrolled by 4.
-#if 0
-void R_DrawSpan (void) 
-{ 
-    unsigned	position, step;
+//
+// R_DrawSpanUnrolled
+// Same output as R_DrawSpan, four pixels per iteration.
+// Positions are stepped independently from a common base
+//  (packed adds wrap the same way as repeated ones), and the
+//  source and colormap are held in locals, since every store
+//  through dest may otherwise alias the globals.
+//
+#define SPANSPOT(p)	((((p) >> 4) & 0x0fc0) | ((p) >> 26))
+
+void R_DrawSpanUnrolled (void)
+{
+    unsigned int position, step, step2, step3, step4;
+    byte *source;
+    byte *colormap;
+    byte *dest;
+    int count;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+    step2 = step * 2;
+    step3 = step * 3;
+    step4 = step * 4;
 
-    byte*	source;
-    byte*	colormap;
-    byte*	dest;
-    
-    unsigned	count;
-    usingned	spot; 
-    unsigned	value;
-    unsigned	temp;
-    unsigned	xtemp;
-    unsigned	ytemp;
-		
-    position = ((ds_xfrac<<10)&0xffff0000) | ((ds_yfrac>>6)&0xffff);
-    step = ((ds_xstep<<10)&0xffff0000) | ((ds_ystep>>6)&0xffff);
-		
     source = ds_source;
     colormap = ds_colormap;
-    dest = ylookup[ds_y] + columnofs[ds_x1];	 
-    count = ds_x2 - ds_x1 + 1; 
-	
-    while (count >= 4) 
-    { 
-	ytemp = position>>4;
-	ytemp = ytemp & 4032;
-	xtemp = position>>26;
-	spot = xtemp | ytemp;
-	position += step;
-	dest[0] = colormap[source[spot]]; 
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
 
-	ytemp = position>>4;
-	ytemp = ytemp & 4032;
-	xtemp = position>>26;
-	spot = xtemp | ytemp;
-	position += step;
-	dest[1] = colormap[source[spot]];
-	
-	ytemp = position>>4;
-	ytemp = ytemp & 4032;
-	xtemp = position>>26;
-	spot = xtemp | ytemp;
-	position += step;
-	dest[2] = colormap[source[spot]];
-	
-	ytemp = position>>4;
-	ytemp = ytemp & 4032;
-	xtemp = position>>26;
-	spot = xtemp | ytemp;
-	position += step;
-	dest[3] = colormap[source[spot]]; 
-		
-	count -= 4;
+    while (count >= 4)
+    {
+	dest[0] = colormap[source[SPANSPOT(position)]];
+	dest[1] = colormap[source[SPANSPOT(position + step)]];
+	dest[2] = colormap[source[SPANSPOT(position + step2)]];
+	dest[3] = colormap[source[SPANSPOT(position + step3)]];
+
+	position += step4;
 	dest += 4;
-    } 
-    while (count > 0) 
-    { 
-	ytemp = position>>4;
-	ytemp = ytemp & 4032;
-	xtemp = position>>26;
-	spot = xtemp | ytemp;
+	count -= 4;
+    }
+
+    while (count > 0)
+    {
+	*dest++ = colormap[source[SPANSPOT(position)]];
 	position += step;
-	*dest++ = colormap[source[spot]]; 
 	count--;
-    } 
-} 
-#endif
+    }
+}
 
 
 //
@@ -766,6 +732,75 @@ void R_DrawSpanLow (void)
     } while (count--);
 }
 
+
+//
+// R_DrawSpanLowUnrolled
+// Blocky mode counterpart of R_DrawSpanUnrolled.
+//
+void R_DrawSpanLowUnrolled (void)
+{
+    unsigned int position, step, step2, step3, step4;
+    byte *source;
+    byte *colormap;
+    byte *dest;
+    int count;
+    byte pixel;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=SCREENWIDTH
+	|| (unsigned)ds_y>SCREENHEIGHT)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    position = ((ds_xfrac << 10) & 0xffff0000)
+             | ((ds_yfrac >> 6)  & 0x0000ffff);
+    step = ((ds_xstep << 10) & 0xffff0000)
+         | ((ds_ystep >> 6)  & 0x0000ffff);
+    step2 = step * 2;
+    step3 = step * 3;
+    step4 = step * 4;
+
+    source = ds_source;
+    colormap = ds_colormap;
+    count = ds_x2 - ds_x1 + 1;
+
+    // Blocky mode, need to multiply by 2.
+    ds_x1 <<= 1;
+    ds_x2 <<= 1;
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+
+    while (count >= 4)
+    {
+	pixel = colormap[source[SPANSPOT(position)]];
+	dest[0] = dest[1] = pixel;
+	pixel = colormap[source[SPANSPOT(position + step)]];
+	dest[2] = dest[3] = pixel;
+	pixel = colormap[source[SPANSPOT(position + step2)]];
+	dest[4] = dest[5] = pixel;
+	pixel = colormap[source[SPANSPOT(position + step3)]];
+	dest[6] = dest[7] = pixel;
+
+	position += step4;
+	dest += 8;
+	count -= 4;
+    }
+
+    while (count > 0)
+    {
+	pixel = colormap[source[SPANSPOT(position)]];
+	dest[0] = dest[1] = pixel;
+	position += step;
+	dest += 2;
+	count--;
+    }
+}
+
 //
 // R_InitBuffer 
 // Creats lookup tables that avoid
@@ -32,6 +32,9 @@ extern fixed_t		dc_texturemid;
 
 // first pixel in a column
 extern byte*		dc_source;		
+extern int		dc_texheight;
+
+typedef void (*colfunc_t) (void);
 
 
 // The span blitting interface.
@@ -40,6 +43,14 @@ extern byte*		dc_source;
 void 	R_DrawColumn (void);
 void 	R_DrawColumnLow (void);
 
+// Wall column drawers for other texture heights.
+void 	R_DrawColumnPow2 (void);
+void 	R_DrawColumnPow2Low (void);
+void 	R_DrawColumnNonPow2 (void);
+void 	R_DrawColumnNonPow2Low (void);
+
+colfunc_t R_WallColumnFunc (int height);
+
 // The Spectre/Invisibility effect.
 void 	R_DrawFuzzColumn (void);
 void 	R_DrawFuzzColumnLow (void);
@@ -80,6 +91,10 @@ void 	R_DrawSpan (void);
 // Low resolution mode, 160x200?
 void 	R_DrawSpanLow (void);
 
+// Unrolled versions of the above, used by default.
+void 	R_DrawSpanUnrolled (void);
+void 	R_DrawSpanLowUnrolled (void);
+
 
 void
 R_InitBuffer
@@ -47,6 +47,14 @@ int		toptexture;
 int		bottomtexture;
 int		midtexture;
 
+// column drawers and heights for each tier, by texture height
+colfunc_t	topcolfunc;
+colfunc_t	bottomcolfunc;
+colfunc_t	midcolfunc;
+int		toptexheight;
+int		bottomtexheight;
+int		midtexheight;
+
 
 angle_t		rw_normalangle;
 // angle to line origin
@@ -281,7 +289,8 @@ void R_RenderSegLoop (void)
 	    dc_yh = yh;
 	    dc_texturemid = rw_midtexturemid;
 	    dc_source = R_GetColumn(midtexture,texturecolumn);
-	    colfunc ();
+	    dc_texheight = midtexheight;
+	    midcolfunc ();
 	    ceilingclip[rw_x] = viewheight;
 	    floorclip[rw_x] = -1;
 	}
@@ -303,7 +312,8 @@ void R_RenderSegLoop (void)
 		    dc_yh = mid;
 		    dc_texturemid = rw_toptexturemid;
 		    dc_source = R_GetColumn(toptexture,texturecolumn);
-		    colfunc ();
+		    dc_texheight = toptexheight;
+		    topcolfunc ();
 		    ceilingclip[rw_x] = mid;
 		}
 		else
@@ -333,7 +343,8 @@ void R_RenderSegLoop (void)
 		    dc_texturemid = rw_bottomtexturemid;
 		    dc_source = R_GetColumn(bottomtexture,
 					    texturecolumn);
-		    colfunc ();
+		    dc_texheight = bottomtexheight;
+		    bottomcolfunc ();
 		    floorclip[rw_x] = mid;
 		}
 		else
@@ -613,6 +624,23 @@ R_StoreWallRange
     // calculate rw_offset (only needed for textured lines)
     segtextured = midtexture | toptexture | bottomtexture | maskedtexture;
 
+    // pick the column drawers for the tier texture heights
+    if (midtexture)
+    {
+	midtexheight = textureheight[midtexture]>>FRACBITS;
+	midcolfunc = R_WallColumnFunc (midtexheight);
+    }
+    if (toptexture)
+    {
+	toptexheight = textureheight[toptexture]>>FRACBITS;
+	topcolfunc = R_WallColumnFunc (toptexheight);
+    }
+    if (bottomtexture)
+    {
+	bottomtexheight = textureheight[bottomtexture]>>FRACBITS;
+	bottomcolfunc = R_WallColumnFunc (bottomtexheight);
+    }
+
     if (segtextured)
     {
 	offsetangle = rw_normalangle-rw_angle1;
@@ -21,6 +21,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 #include "deh_main.h"
@@ -76,6 +77,21 @@ short		negonearray[SCREENWIDTH];
 short		screenheightarray[SCREENWIDTH];
 
 
+//
+// Drawseg column buckets.
+// Each bucket covers DSBUCKETWIDTH screen columns and holds a bitmask of
+//  the drawsegs that overlap it and can clip sprites. R_DrawSprite ORs the
+//  buckets under the sprite and walks the set bits from the highest index
+//  down, which visits the same segs in the same order as a full scan.
+//
+#define DSBUCKETSHIFT		4
+#define DSBUCKETWIDTH		(1<<DSBUCKETSHIFT)
+#define NUMDSBUCKETS		((SCREENWIDTH+DSBUCKETWIDTH-1)>>DSBUCKETSHIFT)
+#define DSMASKWORDS		((MAXDRAWSEGS+31)/32)
+
+static unsigned int	dsbuckets[NUMDSBUCKETS][DSMASKWORDS];
+
+
 //
 // INITIALIZATION FUNCTIONS
 //
@@ -178,6 +194,7 @@ void R_InitSpriteDefs (char** namelist)
     int		start;
     int		end;
     int		patched;
+    uint32_t	spritekey;
 		
     // count the number of sprite names
     check = namelist;
@@ -200,6 +217,7 @@ void R_InitSpriteDefs (char** namelist)
     for (i=0 ; i<numsprites ; i++)
     {
 	spritename = DEH_String(namelist[i]);
+	spritekey = (uint32_t) W_LumpNameKey (spritename);
 	memset (sprtemp,-1, sizeof(sprtemp));
 		
 	maxframe = -1;
@@ -208,7 +226,7 @@ void R_InitSpriteDefs (char** namelist)
 	//  filling in the frames for whatever is found
 	for (l=start+1 ; l<end ; l++)
 	{
-	    if (!strncasecmp(lumpinfo[l].name, spritename, 4))
+	    if ((uint32_t) lumpinfo[l].key == spritekey)
 	    {
 		frame = lumpinfo[l].name[4] - 'A';
 		rotation = lumpinfo[l].name[5] - '0';
@@ -829,6 +847,55 @@ void R_SortVisSprites (void)
 
 
 
+//
+// R_HighestBit
+// Index of the most significant set bit of a non-zero word.
+//
+static int R_HighestBit (unsigned int bits)
+{
+#if defined(__GNUC__)
+    return 31 - __builtin_clz (bits);
+#else
+    int		b = 0;
+
+    if (bits & 0xffff0000) { bits >>= 16; b += 16; }
+    if (bits & 0xff00) { bits >>= 8; b += 8; }
+    if (bits & 0xf0) { bits >>= 4; b += 4; }
+    if (bits & 0xc) { bits >>= 2; b += 2; }
+    if (bits & 0x2) { b += 1; }
+
+    return b;
+#endif
+}
+
+
+//
+// R_BucketDrawSegs
+// Called once after the BSP walk, before any sprite is drawn.
+// Drawsegs without silhouette or masked texture never clip a
+//  sprite and are left out.
+//
+static void R_BucketDrawSegs (void)
+{
+    drawseg_t*		ds;
+    int			i;
+    int			b;
+
+    memset (dsbuckets, 0, sizeof(dsbuckets));
+
+    for (ds = drawsegs ; ds < ds_p ; ds++)
+    {
+	if (!ds->silhouette && !ds->maskedtexturecol)
+	    continue;
+
+	i = ds - drawsegs;
+
+	for (b = ds->x1 >> DSBUCKETSHIFT ; b <= ds->x2 >> DSBUCKETSHIFT ; b++)
+	    dsbuckets[b][i >> 5] |= 1u << (i & 31);
+    }
+}
+
+
 //
 // R_DrawSprite
 //
@@ -843,20 +910,34 @@ void R_DrawSprite (vissprite_t* spr)
     fixed_t		scale;
     fixed_t		lowscale;
     int			silhouette;
+    unsigned int	mask[DSMASKWORDS];
+    unsigned int	bits;
+    int			b;
+    int			w;
 		
     for (x = spr->x1 ; x<=spr->x2 ; x++)
 	clipbot[x] = cliptop[x] = -2;
-    
+
+    // Gather the drawsegs overlapping the sprite's columns.
+    for (w = 0 ; w < DSMASKWORDS ; w++)
+	mask[w] = 0;
+
+    for (b = spr->x1 >> DSBUCKETSHIFT ; b <= spr->x2 >> DSBUCKETSHIFT ; b++)
+	for (w = 0 ; w < DSMASKWORDS ; w++)
+	    mask[w] |= dsbuckets[b][w];
+
     // Scan drawsegs from end to start for obscuring segs.
     // The first drawseg that has a greater scale
     //  is the clip seg.
-    for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
+    for (w = DSMASKWORDS-1 ; w >= 0 ; w--)
+    for (bits = mask[w] ; bits ; bits &= ~(1u << b))
     {
+	b = R_HighestBit (bits);
+	ds = &drawsegs[w*32 + b];
+
 	// determine if the drawseg obscures the sprite
 	if (ds->x1 > spr->x2
-	    || ds->x2 < spr->x1
-	    || (!ds->silhouette
-		&& !ds->maskedtexturecol) )
+	    || ds->x2 < spr->x1)
 	{
 	    // does not cover sprite
 	    continue;
@@ -954,6 +1035,7 @@ void R_DrawMasked (void)
     drawseg_t*		ds;
 	
     R_SortVisSprites ();
+    R_BucketDrawSegs ();
 
     if (vissprite_p > vissprites)
     {
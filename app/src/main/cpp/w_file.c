@@ -18,58 +18,64 @@
 
 #include <stdio.h>
 
-#include "m_misc.h"
-
+#include "doomtype.h"
 #include "w_file.h"
-#include "z_zone.h"
 
-typedef struct {
-    wad_file_t wad;
-    FILE *fstream;
-} stdc_wad_file_t;
+#ifdef __ANDROID__
+#include "AndroidDriver.h"
+#endif
+
+extern wad_file_class_t lz4_wad_file;
+extern wad_file_class_t stdc_wad_file;
 
-wad_file_t *W_OpenFile(const char *path)
+// Classes are tried in order; the stdio class opens anything, so
+// it comes last. A plain WAD is opened twice, once by the LZ4 class
+// to look at its header; on Android that is two asset opens.
+
+static wad_file_class_t *wad_file_classes[] =
 {
-    stdc_wad_file_t *result;
-    FILE *fstream = NULL;
+    &lz4_wad_file,
+    &stdc_wad_file,
+};
 
+FILE *W_OpenStream(const char *path)
+{
 #ifdef __ANDROID__
-#include "AndroidDriver.h"
-    fstream = android_fopen(path, "rb");
+    return android_fopen(path, "rb");
 #else
-    fstream = fopen(path, "rb");
+    return fopen(path, "rb");
 #endif
+}
 
-    if (fstream == NULL)
-        return NULL;
+wad_file_t *W_OpenFile(const char *path)
+{
+    wad_file_t *result;
+    int i;
+
+    // Try all classes in order until we find one that works
+
+    result = NULL;
 
-    // Create a new stdc_wad_file_t to hold the file handle.
+    for (i = 0; i < ARRLEN(wad_file_classes); ++i)
+    {
+        result = wad_file_classes[i]->OpenFile(path);
 
-    result = Z_Malloc(sizeof(stdc_wad_file_t), PU_STATIC, 0);
-    result->wad.mapped = NULL;
-    result->wad.length = M_FileLength(fstream);
-    result->fstream = fstream;
+        if (result != NULL)
+        {
+            break;
+        }
+    }
 
-    return &result->wad;
+    return result;
 }
 
 void W_CloseFile(wad_file_t *wad)
 {
-    stdc_wad_file_t *stdc_wad = (stdc_wad_file_t *) wad;
-
-    fclose(stdc_wad->fstream);
-    Z_Free(stdc_wad);
+    wad->file_class->CloseFile(wad);
 }
 
 size_t W_Read(wad_file_t *wad, long offset, void *buffer, size_t buffer_len)
 {
-    stdc_wad_file_t *stdc_wad = (stdc_wad_file_t *) wad;
-
-    // Jump to the specified position in the file.
-    fseek(stdc_wad->fstream, offset, SEEK_SET);
-
-    // Read into the buffer.
-    size_t result = fread(buffer, 1, buffer_len, stdc_wad->fstream);
-
-    return result;
+    return wad->file_class->Read(wad, offset, buffer, buffer_len);
 }
+
@@ -19,16 +19,45 @@
 #ifndef W_FILE_H
 #define W_FILE_H
 
+#include <stdio.h>
+
 #include "doomtype.h"
 
-typedef struct {
+typedef struct _wad_file_s wad_file_t;
+
+typedef struct
+{
+    // Open a file for reading.
+
+    wad_file_t *(*OpenFile)(const char *path);
+
+    // Close the specified file.
+
+    void (*CloseFile)(wad_file_t *file);
+
+    // Read data from the specified position in the file into the
+    // provided buffer.  Returns the number of bytes read.
+
+    size_t (*Read)(wad_file_t *file, long offset,
+                   void *buffer, size_t buffer_len);
+
+} wad_file_class_t;
+
+struct _wad_file_s
+{
+    // Class of this file.
+
+    wad_file_class_t *file_class;
+
     // If this is NULL, the file cannot be mapped into memory.  If this
     // is non-NULL, it is a pointer to the mapped file.
+
     byte *mapped;
 
     // Length of the file, in bytes.
+
     unsigned int length;
-} wad_file_t;
+};
 
 // Open the specified file. Returns a pointer to a new wad_file_t
 // handle for the WAD file, or NULL if it could not be opened.
@@ -42,4 +71,8 @@ void W_CloseFile(wad_file_t *wad);
 // Returns the number of bytes read.
 size_t W_Read(wad_file_t *wad, long offset, void *buffer, size_t buffer_len);
 
+// Open a file with stdio for the file classes to read. On Android
+// the path is looked up in the APK's assets.
+FILE *W_OpenStream(const char *path);
+
 #endif /* W_FILE_H */
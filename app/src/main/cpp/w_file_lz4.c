@@ -0,0 +1,392 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	WAD I/O functions for compressed WAD containers.
+//
+//	A container holds a WAD cut into blocks at every lump boundary,
+//	each block compressed on its own in the LZ4 block format (or
+//	stored, where that is no smaller).  Reads are of the WAD as it
+//	was, so the rest of the engine does not know the difference; a
+//	lump is one block, found by a binary search of the block table
+//	and decompressed straight into the buffer it is being read into.
+//	tools/wadpack.c makes containers from WADs.
+//
+//	Layout, all numbers 32-bit little endian:
+//
+//	    "WLZ4" length numblocks tableofs
+//	    compressed blocks ...
+//	    block table at tableofs: numblocks of
+//	        offset size fileofs packedsize
+//
+//	Blocks are in order of offset and cover the WAD with no gaps.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "i_swap.h"
+#include "i_system.h"
+#include "w_file.h"
+#include "z_zone.h"
+
+typedef struct
+{
+    char id[4];
+    unsigned int length;
+    unsigned int numblocks;
+    unsigned int tableofs;
+} PACKEDATTR lz4header_t;
+
+typedef struct
+{
+    unsigned int offset;        // position in the WAD
+    unsigned int size;
+    unsigned int fileofs;       // position in the container
+    unsigned int packedsize;    // == size if stored
+} PACKEDATTR lz4block_t;
+
+typedef struct
+{
+    wad_file_t wad;
+    FILE *fstream;
+
+    lz4block_t *blocks;
+    int numblocks;
+
+    // Compressed data as read from the file
+    byte *packed;
+    unsigned int packedalloced;
+
+    // The last block decompressed for a read of part of it
+    byte *unpacked;
+    unsigned int unpackedalloced;
+    int unpackedblock;
+} lz4_wad_file_t;
+
+extern wad_file_class_t lz4_wad_file;
+
+static void *GrowBuffer(void *buffer, unsigned int *alloced,
+                        unsigned int size)
+{
+    if (size > *alloced)
+    {
+        buffer = realloc(buffer, size);
+
+        if (buffer == NULL)
+        {
+            I_Error("W_LZ4_Read: out of memory for a %u byte block", size);
+        }
+
+        *alloced = size;
+    }
+
+    return buffer;
+}
+
+//
+// Decompress an LZ4 block. Returns the length of the output, or -1
+// if the input is damaged or would not fit.
+//
+static int LZ4_Decompress(const byte *src, int srclen, byte *dest, int destlen)
+{
+    const byte *ip = src;
+    const byte *iend = src + srclen;
+    byte *op = dest;
+    byte *oend = dest + destlen;
+    int token, length, offset;
+    int b;
+
+    while (ip < iend)
+    {
+        token = *ip++;
+
+        // literals
+
+        length = token >> 4;
+
+        if (length == 15)
+        {
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+
+        if (length > iend - ip || length > oend - op)
+            return -1;
+
+        memcpy(op, ip, length);
+        op += length;
+        ip += length;
+
+        // The last sequence has no match.
+
+        if (ip >= iend)
+            break;
+
+        if (iend - ip < 2)
+            return -1;
+
+        offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+
+        if (offset == 0 || offset > op - dest)
+            return -1;
+
+        length = token & 15;
+
+        if (length == 15)
+        {
+            do
+            {
+                if (ip >= iend)
+                    return -1;
+
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+
+        length += 4;
+
+        if (length > oend - op)
+            return -1;
+
+        // A match may overlap what it is copying, to repeat a pattern.
+
+        if (offset >= length)
+        {
+            memcpy(op, op - offset, length);
+            op += length;
+        }
+        else
+        {
+            const byte *match = op - offset;
+
+            while (length-- > 0)
+                *op++ = *match++;
+        }
+    }
+
+    return op - dest;
+}
+
+static wad_file_t *W_LZ4_OpenFile(const char *path)
+{
+    lz4_wad_file_t *result;
+    lz4header_t header;
+    FILE *fstream;
+    int i;
+
+    fstream = W_OpenStream(path);
+
+    if (fstream == NULL)
+    {
+        return NULL;
+    }
+
+    // Anything else is for the other classes to open.
+
+    if (fread(&header, sizeof(header), 1, fstream) != 1
+     || strncmp(header.id, "WLZ4", 4))
+    {
+        fclose(fstream);
+        return NULL;
+    }
+
+    result = Z_Malloc(sizeof(lz4_wad_file_t), PU_STATIC, 0);
+    result->wad.file_class = &lz4_wad_file;
+    result->wad.mapped = NULL;
+    result->wad.length = LONG(header.length);
+    result->fstream = fstream;
+
+    result->numblocks = LONG(header.numblocks);
+    result->blocks = Z_Malloc(result->numblocks * sizeof(lz4block_t),
+                              PU_STATIC, 0);
+
+    if (fseek(fstream, LONG(header.tableofs), SEEK_SET) != 0
+     || fread(result->blocks, sizeof(lz4block_t), result->numblocks,
+              fstream) != (size_t) result->numblocks)
+    {
+        I_Error("W_LZ4_OpenFile: %s has a damaged block table", path);
+    }
+
+    for (i = 0; i < result->numblocks; ++i)
+    {
+        result->blocks[i].offset = LONG(result->blocks[i].offset);
+        result->blocks[i].size = LONG(result->blocks[i].size);
+        result->blocks[i].fileofs = LONG(result->blocks[i].fileofs);
+        result->blocks[i].packedsize = LONG(result->blocks[i].packedsize);
+    }
+
+    result->packed = NULL;
+    result->packedalloced = 0;
+    result->unpacked = NULL;
+    result->unpackedalloced = 0;
+    result->unpackedblock = -1;
+
+    return &result->wad;
+}
+
+static void W_LZ4_CloseFile(wad_file_t *wad)
+{
+    lz4_wad_file_t *lz4_wad;
+
+    lz4_wad = (lz4_wad_file_t *) wad;
+
+    fclose(lz4_wad->fstream);
+    free(lz4_wad->packed);
+    free(lz4_wad->unpacked);
+    Z_Free(lz4_wad->blocks);
+    Z_Free(lz4_wad);
+}
+
+// Find the block holding the given offset.
+
+static int FindBlock(lz4_wad_file_t *lz4_wad, unsigned int offset)
+{
+    int lo, hi, mid;
+
+    lo = 0;
+    hi = lz4_wad->numblocks - 1;
+
+    while (lo < hi)
+    {
+        mid = (lo + hi + 1) / 2;
+
+        if (lz4_wad->blocks[mid].offset <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+// Read a whole block into dest. Returns false if it cannot be read.
+
+static boolean ReadBlock(lz4_wad_file_t *lz4_wad, lz4block_t *block,
+                         byte *dest)
+{
+    if (fseek(lz4_wad->fstream, block->fileofs, SEEK_SET) != 0)
+    {
+        return false;
+    }
+
+    // Stored blocks go straight to the destination.
+
+    if (block->packedsize == block->size)
+    {
+        return fread(dest, 1, block->size, lz4_wad->fstream) == block->size;
+    }
+
+    lz4_wad->packed = GrowBuffer(lz4_wad->packed, &lz4_wad->packedalloced,
+                                 block->packedsize);
+
+    if (fread(lz4_wad->packed, 1, block->packedsize, lz4_wad->fstream)
+        != block->packedsize)
+    {
+        return false;
+    }
+
+    return LZ4_Decompress(lz4_wad->packed, block->packedsize,
+                          dest, block->size) == (int) block->size;
+}
+
+static size_t W_LZ4_Read(wad_file_t *wad, long offset,
+                         void *buffer, size_t buffer_len)
+{
+    lz4_wad_file_t *lz4_wad;
+    byte *dest = buffer;
+    size_t result;
+    int b;
+
+    lz4_wad = (lz4_wad_file_t *) wad;
+
+    if (offset < 0 || lz4_wad->numblocks == 0)
+    {
+        return 0;
+    }
+
+    result = 0;
+
+    for (b = FindBlock(lz4_wad, offset);
+         b < lz4_wad->numblocks && result < buffer_len; ++b)
+    {
+        lz4block_t *block = &lz4_wad->blocks[b];
+        unsigned int within = offset + result - block->offset;
+        size_t count;
+
+        if (within >= block->size)
+        {
+            break;
+        }
+
+        count = block->size - within;
+
+        if (count > buffer_len - result)
+        {
+            count = buffer_len - result;
+        }
+
+        if (within == 0 && count == block->size)
+        {
+            // The usual case: all of one lump.
+
+            if (!ReadBlock(lz4_wad, block, dest + result))
+            {
+                break;
+            }
+        }
+        else
+        {
+            // Part of a block; keep it for the reads of the rest.
+
+            if (lz4_wad->unpackedblock != b)
+            {
+                lz4_wad->unpacked = GrowBuffer(lz4_wad->unpacked,
+                                               &lz4_wad->unpackedalloced,
+                                               block->size);
+                lz4_wad->unpackedblock = -1;
+
+                if (!ReadBlock(lz4_wad, block, lz4_wad->unpacked))
+                {
+                    break;
+                }
+
+                lz4_wad->unpackedblock = b;
+            }
+
+            memcpy(dest + result, lz4_wad->unpacked + within, count);
+        }
+
+        result += count;
+    }
+
+    return result;
+}
+
+
+wad_file_class_t lz4_wad_file =
+{
+    W_LZ4_OpenFile,
+    W_LZ4_CloseFile,
+    W_LZ4_Read,
+};
+
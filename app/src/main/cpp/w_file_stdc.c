@@ -30,12 +30,12 @@ typedef struct
 
 extern wad_file_class_t stdc_wad_file;
 
-static wad_file_t *W_StdC_OpenFile(char *path)
+static wad_file_t *W_StdC_OpenFile(const char *path)
 {
     stdc_wad_file_t *result;
     FILE *fstream;
 
-    fstream = fopen(path, "rb");
+    fstream = W_OpenStream(path);
 
     if (fstream == NULL)
     {
@@ -66,8 +66,8 @@ static void W_StdC_CloseFile(wad_file_t *wad)
 // Read data from the specified position in the file into the 
 // provided buffer.  Returns the number of bytes read.
 
-size_t W_StdC_Read(wad_file_t *wad, unsigned int offset,
-                   void *buffer, size_t buffer_len)
+static size_t W_StdC_Read(wad_file_t *wad, long offset,
+                          void *buffer, size_t buffer_len)
 {
     stdc_wad_file_t *stdc_wad;
     size_t result;
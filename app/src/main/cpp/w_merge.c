@@ -0,0 +1,861 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+// Handles merging of PWADs, similar to deutex's -merge option
+//
+// Ideally this should work exactly the same as in deutex, but trying to
+// read the deutex source code made my brain hurt.
+//
+// Every name search here goes through a hash table of lump name keys
+// (W_LumpNameKey), built once per merge, so merging is linear in the
+// size of the directory rather than quadratic.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "m_misc.h"
+#include "w_merge.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+typedef enum
+{
+    SECTION_NORMAL,
+    SECTION_FLATS,
+    SECTION_SPRITES,
+} section_t;
+
+typedef struct
+{
+    lumpinfo_t *lumps;
+    int numlumps;
+} searchlist_t;
+
+typedef struct
+{
+    uint64_t key;       // sprite name and frame letter (SpriteFrameKey)
+    lumpinfo_t *angle_lumps[8];
+} sprite_frame_t;
+
+// Open addressing table from a key to an index into some list.
+
+typedef struct
+{
+    uint64_t key;
+    int index;          // -1 if the slot is empty
+} keyslot_t;
+
+typedef struct
+{
+    keyslot_t *slots;
+    unsigned int mask;
+} keyhash_t;
+
+static searchlist_t iwad;
+static searchlist_t iwad_sprites;
+static searchlist_t iwad_flats;
+
+static searchlist_t pwad;
+static searchlist_t pwad_sprites;
+static searchlist_t pwad_flats;
+
+// lumps with these sprites must be replaced in the IWAD
+static sprite_frame_t *sprite_frames;
+static int num_sprite_frames;
+static int sprite_frames_alloced;
+static keyhash_t sprite_frame_hash;
+
+static void InitKeyHash(keyhash_t *hash, int count)
+{
+    unsigned int size = 64;
+
+    while (size < (unsigned int) count * 2)
+        size <<= 1;
+
+    hash->slots = malloc(size * sizeof(keyslot_t));
+
+    if (hash->slots == NULL)
+        I_Error("InitKeyHash: out of memory");
+
+    hash->mask = size - 1;
+
+    for (unsigned int i = 0; i < size; ++i)
+        hash->slots[i].index = -1;
+}
+
+static void FreeKeyHash(keyhash_t *hash)
+{
+    free(hash->slots);
+    hash->slots = NULL;
+}
+
+static keyslot_t *KeyHashSlot(keyhash_t *hash, uint64_t key)
+{
+    unsigned int slot;
+
+    slot = (unsigned int) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & hash->mask;
+
+    while (hash->slots[slot].index != -1 && hash->slots[slot].key != key)
+        slot = (slot + 1) & hash->mask;
+
+    return &hash->slots[slot];
+}
+
+// Hash the names in a list. Where a name repeats, the first lump
+// with it is the one found, as with a search from the start.
+
+static void HashList(keyhash_t *hash, searchlist_t *list)
+{
+    InitKeyHash(hash, list->numlumps);
+
+    for (int i = 0; i < list->numlumps; ++i)
+    {
+        keyslot_t *slot = KeyHashSlot(hash, list->lumps[i].key);
+
+        if (slot->index == -1)
+        {
+            slot->key = list->lumps[i].key;
+            slot->index = i;
+        }
+    }
+}
+
+static int FindInHash(keyhash_t *hash, uint64_t key)
+{
+    return KeyHashSlot(hash, key)->index;
+}
+
+// Search in a list to find a lump with a particular name.
+// Only used for the section markers, which are looked for once.
+
+static int FindInList(searchlist_t *list, char *name)
+{
+    uint64_t key = W_LumpNameKey(name);
+
+    for (int i = 0; i < list->numlumps; ++i)
+    {
+        if (list->lumps[i].key == key)
+            return i;
+    }
+
+    return -1;
+}
+
+static boolean SetupList(searchlist_t *list, searchlist_t *src_list,
+                         char *startname, char *endname,
+                         char *startname2, char *endname2)
+{
+    int startlump, endlump;
+
+    list->numlumps = 0;
+    startlump = FindInList(src_list, startname);
+
+    if (startname2 != NULL && startlump < 0)
+    {
+        startlump = FindInList(src_list, startname2);
+    }
+
+    if (startlump >= 0)
+    {
+        endlump = FindInList(src_list, endname);
+
+        if (endname2 != NULL && endlump < 0)
+        {
+            endlump = FindInList(src_list, endname2);
+        }
+
+        if (endlump > startlump)
+        {
+            list->lumps = src_list->lumps + startlump + 1;
+            list->numlumps = endlump - startlump - 1;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Sets up the sprite/flat search lists
+
+static void SetupLists(void)
+{
+    // IWAD
+
+    if (!SetupList(&iwad_flats, &iwad, "F_START", "F_END", NULL, NULL))
+    {
+        I_Error("Flats section not found in IWAD");
+    }
+
+    if (!SetupList(&iwad_sprites, &iwad, "S_START", "S_END", NULL, NULL))
+
+    {
+        I_Error("Sprites section not found in IWAD");
+    }
+
+    // PWAD
+
+    SetupList(&pwad_flats, &pwad, "F_START", "F_END", "FF_START", "FF_END");
+    SetupList(&pwad_sprites, &pwad, "S_START", "S_END", "SS_START", "SS_END");
+}
+
+// Split the directory into the IWAD part, which was there before the
+// PWAD was added, and the PWAD part.
+
+static void SplitDirectory(int old_numlumps)
+{
+    iwad.lumps = lumpinfo;
+    iwad.numlumps = old_numlumps;
+
+    pwad.lumps = lumpinfo + old_numlumps;
+    pwad.numlumps = numlumps - old_numlumps;
+}
+
+// Lumps are about to move about in lumpinfo[], so nothing can keep
+// pointing into it; anything cached will be loaded again when needed.
+
+static void FlushLumpCache(void)
+{
+    for (unsigned int i = 0; i < numlumps; ++i)
+    {
+        if (lumpinfo[i].cache != NULL)
+        {
+            Z_Free(lumpinfo[i].cache);
+        }
+    }
+}
+
+// Initialise the replace list
+
+static void InitSpriteList(void)
+{
+    if (sprite_frames == NULL)
+    {
+        sprite_frames_alloced = 128;
+        sprite_frames = Z_Malloc(sizeof(*sprite_frames) * sprite_frames_alloced,
+                                 PU_STATIC, NULL);
+    }
+
+    num_sprite_frames = 0;
+
+    InitKeyHash(&sprite_frame_hash,
+                iwad_sprites.numlumps + pwad_sprites.numlumps);
+}
+
+static boolean ValidSpriteLumpName(char *name)
+{
+    if (name[0] == '\0' || name[1] == '\0'
+     || name[2] == '\0' || name[3] == '\0')
+    {
+        return false;
+    }
+
+    // First frame
+
+    if (name[4] == '\0' || !isdigit(name[5]))
+    {
+        return false;
+    }
+
+    // Second frame (optional)
+
+    if (name[6] != '\0' && !isdigit(name[7]))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// The sprite name (upper case, from the lump key) with the frame
+// letter above it. The letter is compared as it is, not folded.
+
+static uint64_t SpriteFrameKey(lumpinfo_t *lump, int frame)
+{
+    return (lump->key & 0xffffffffULL) | ((uint64_t) (frame & 0xff) << 32);
+}
+
+// Find a sprite frame
+
+static sprite_frame_t *FindSpriteFrame(lumpinfo_t *lump, int frame)
+{
+    sprite_frame_t *result;
+    keyslot_t *slot;
+    uint64_t key;
+    int i;
+
+    key = SpriteFrameKey(lump, frame);
+    slot = KeyHashSlot(&sprite_frame_hash, key);
+
+    if (slot->index != -1)
+    {
+        return &sprite_frames[slot->index];
+    }
+
+    // Not found in list; Need to add to the list
+
+    // Grow list?
+
+    if (num_sprite_frames >= sprite_frames_alloced)
+    {
+        sprite_frame_t *newframes;
+
+        newframes = Z_Malloc(sprite_frames_alloced * 2 * sizeof(*sprite_frames),
+                             PU_STATIC, NULL);
+        memcpy(newframes, sprite_frames,
+               sprite_frames_alloced * sizeof(*sprite_frames));
+        Z_Free(sprite_frames);
+        sprite_frames_alloced *= 2;
+        sprite_frames = newframes;
+    }
+
+    // Add to end of list
+
+    result = &sprite_frames[num_sprite_frames];
+    result->key = key;
+
+    for (i=0; i<8; ++i)
+        result->angle_lumps[i] = NULL;
+
+    slot->key = key;
+    slot->index = num_sprite_frames;
+
+    ++num_sprite_frames;
+
+    return result;
+}
+
+// Check if sprite lump is needed in the new wad
+
+static boolean SpriteLumpNeeded(lumpinfo_t *lump)
+{
+    sprite_frame_t *sprite;
+    int angle_num;
+    int i;
+
+    if (!ValidSpriteLumpName(lump->name))
+    {
+        return true;
+    }
+
+    // check the first frame
+
+    sprite = FindSpriteFrame(lump, lump->name[4]);
+    angle_num = lump->name[5] - '0';
+
+    if (angle_num == 0)
+    {
+        // must check all frames
+
+        for (i=0; i<8; ++i)
+        {
+            if (sprite->angle_lumps[i] == lump)
+                return true;
+        }
+    }
+    else
+    {
+        // check if this lump is being used for this frame
+
+        if (sprite->angle_lumps[angle_num - 1] == lump)
+            return true;
+    }
+
+    // second frame if any
+
+    // no second frame?
+    if (lump->name[6] == '\0')
+        return false;
+
+    sprite = FindSpriteFrame(lump, lump->name[6]);
+    angle_num = lump->name[7] - '0';
+
+    if (angle_num == 0)
+    {
+        // must check all frames
+
+        for (i=0; i<8; ++i)
+        {
+            if (sprite->angle_lumps[i] == lump)
+                return true;
+        }
+    }
+    else
+    {
+        // check if this lump is being used for this frame
+
+        if (sprite->angle_lumps[angle_num - 1] == lump)
+            return true;
+    }
+
+    return false;
+}
+
+static void AddSpriteLump(lumpinfo_t *lump)
+{
+    sprite_frame_t *sprite;
+    int angle_num;
+    int i;
+
+    if (!ValidSpriteLumpName(lump->name))
+    {
+        return;
+    }
+
+    // first angle
+
+    sprite = FindSpriteFrame(lump, lump->name[4]);
+    angle_num = lump->name[5] - '0';
+
+    if (angle_num == 0)
+    {
+        for (i=0; i<8; ++i)
+            sprite->angle_lumps[i] = lump;
+    }
+    else
+    {
+        sprite->angle_lumps[angle_num - 1] = lump;
+    }
+
+    // second angle
+
+    // no second angle?
+
+    if (lump->name[6] == '\0')
+        return;
+
+    sprite = FindSpriteFrame(lump, lump->name[6]);
+    angle_num = lump->name[7] - '0';
+
+    if (angle_num == 0)
+    {
+        for (i=0; i<8; ++i)
+            sprite->angle_lumps[i] = lump;
+    }
+    else
+    {
+        sprite->angle_lumps[angle_num - 1] = lump;
+    }
+}
+
+// Generate the list.  Run at the start, before merging
+
+static void GenerateSpriteList(void)
+{
+    int i;
+
+    InitSpriteList();
+
+    // Add all sprites from the IWAD
+
+    for (i=0; i<iwad_sprites.numlumps; ++i)
+    {
+        AddSpriteLump(&iwad_sprites.lumps[i]);
+    }
+
+    // Add all sprites from the PWAD
+    // (replaces IWAD sprites)
+
+    for (i=0; i<pwad_sprites.numlumps; ++i)
+    {
+        AddSpriteLump(&pwad_sprites.lumps[i]);
+    }
+}
+
+// Perform the merge.
+//
+// The merge code creates a new lumpinfo list, adding entries from the
+// IWAD first followed by the PWAD.
+//
+// For the IWAD:
+//  * Flats are added.  If a flat with the same name is in the PWAD,
+//    it is ignored(deleted).  At the end of the section, all flats in the
+//    PWAD are inserted.  This is consistent with the behavior of
+//    deutex/deusf.
+//  * Sprites are added.  The "replace list" is generated before the merge
+//    from the list of sprites in the PWAD.  Any sprites in the IWAD found
+//    to match the replace list are removed.  At the end of the section,
+//    the sprites from the PWAD are inserted.
+//
+// For the PWAD:
+//  * All Sprites and Flats are ignored, with the assumption they have
+//    already been merged into the IWAD's sections.
+
+static void DoMerge(void)
+{
+    uint64_t f_start, f_end, s_start, s_end;
+    uint64_t ff_start, ff_end, ss_start, ss_end;
+    section_t current_section;
+    keyhash_t pwad_flat_hash;
+    lumpinfo_t *newlumps;
+    int num_newlumps;
+    int i, n;
+
+    f_start = W_LumpNameKey("F_START");
+    f_end = W_LumpNameKey("F_END");
+    s_start = W_LumpNameKey("S_START");
+    s_end = W_LumpNameKey("S_END");
+    ff_start = W_LumpNameKey("FF_START");
+    ff_end = W_LumpNameKey("FF_END");
+    ss_start = W_LumpNameKey("SS_START");
+    ss_end = W_LumpNameKey("SS_END");
+
+    HashList(&pwad_flat_hash, &pwad_flats);
+
+    // Can't ever have more lumps than we already have
+    newlumps = calloc(numlumps, sizeof(lumpinfo_t));
+
+    if (newlumps == NULL)
+    {
+        I_Error("DoMerge: out of memory");
+    }
+
+    num_newlumps = 0;
+
+    // Add IWAD lumps
+    current_section = SECTION_NORMAL;
+
+    for (i=0; i<iwad.numlumps; ++i)
+    {
+        lumpinfo_t *lump = &iwad.lumps[i];
+
+        switch (current_section)
+        {
+            case SECTION_NORMAL:
+                if (lump->key == f_start)
+                {
+                    current_section = SECTION_FLATS;
+                }
+                else if (lump->key == s_start)
+                {
+                    current_section = SECTION_SPRITES;
+                }
+
+                newlumps[num_newlumps++] = *lump;
+
+                break;
+
+            case SECTION_FLATS:
+
+                // Have we reached the end of the section?
+
+                if (lump->key == f_end)
+                {
+                    // Add all new flats from the PWAD to the end
+                    // of the section
+
+                    for (n=0; n<pwad_flats.numlumps; ++n)
+                    {
+                        newlumps[num_newlumps++] = pwad_flats.lumps[n];
+                    }
+
+                    newlumps[num_newlumps++] = *lump;
+
+                    // back to normal reading
+                    current_section = SECTION_NORMAL;
+                }
+                else
+                {
+                    // If there is a flat in the PWAD with the same name,
+                    // do not add it now.  All PWAD flats are added to the
+                    // end of the section. Otherwise, if it is only in the
+                    // IWAD, add it now
+
+                    if (FindInHash(&pwad_flat_hash, lump->key) < 0)
+                    {
+                        newlumps[num_newlumps++] = *lump;
+                    }
+                }
+
+                break;
+
+            case SECTION_SPRITES:
+
+                // Have we reached the end of the section?
+
+                if (lump->key == s_end)
+                {
+                    // add all the PWAD sprites
+
+                    for (n=0; n<pwad_sprites.numlumps; ++n)
+                    {
+                        if (SpriteLumpNeeded(&pwad_sprites.lumps[n]))
+                        {
+                            newlumps[num_newlumps++] = pwad_sprites.lumps[n];
+                        }
+                    }
+
+                    // copy the ending
+                    newlumps[num_newlumps++] = *lump;
+
+                    // back to normal reading
+                    current_section = SECTION_NORMAL;
+                }
+                else
+                {
+                    // Is this lump holding a sprite to be replaced in the
+                    // PWAD? If so, wait until the end to add it.
+
+                    if (SpriteLumpNeeded(lump))
+                    {
+                        newlumps[num_newlumps++] = *lump;
+                    }
+                }
+
+                break;
+        }
+    }
+
+    // Add PWAD lumps
+    current_section = SECTION_NORMAL;
+
+    for (i=0; i<pwad.numlumps; ++i)
+    {
+        lumpinfo_t *lump = &pwad.lumps[i];
+
+        switch (current_section)
+        {
+            case SECTION_NORMAL:
+                if (lump->key == f_start || lump->key == ff_start)
+                {
+                    current_section = SECTION_FLATS;
+                }
+                else if (lump->key == s_start || lump->key == ss_start)
+                {
+                    current_section = SECTION_SPRITES;
+                }
+                else
+                {
+                    // Don't include the headers of sections
+
+                    newlumps[num_newlumps++] = *lump;
+                }
+                break;
+
+            case SECTION_FLATS:
+
+                // PWAD flats are ignored (already merged)
+
+                if (lump->key == ff_end || lump->key == f_end)
+                {
+                    // end of section
+                    current_section = SECTION_NORMAL;
+                }
+                break;
+
+            case SECTION_SPRITES:
+
+                // PWAD sprites are ignored (already merged)
+
+                if (lump->key == ss_end || lump->key == s_end)
+                {
+                    // end of section
+                    current_section = SECTION_NORMAL;
+                }
+                break;
+        }
+    }
+
+    FreeKeyHash(&pwad_flat_hash);
+    FreeKeyHash(&sprite_frame_hash);
+
+    // Switch to the new lumpinfo, and free the old one
+
+    free(lumpinfo);
+    lumpinfo = newlumps;
+    numlumps = num_newlumps;
+}
+
+void W_PrintDirectory(void)
+{
+    unsigned int i, n;
+
+    // debug
+    for (i=0; i<numlumps; ++i)
+    {
+        for (n=0; n<8 && lumpinfo[i].name[n] != '\0'; ++n)
+            putchar(lumpinfo[i].name[n]);
+        putchar('\n');
+    }
+}
+
+// Merge in a file by name
+
+void W_MergeFile(char *filename)
+{
+    int old_numlumps;
+
+    old_numlumps = numlumps;
+
+    // Load PWAD
+
+    if (W_AddFile(filename) == NULL)
+        return;
+
+    FlushLumpCache();
+
+    // iwad is at the start, pwad was appended to the end
+
+    SplitDirectory(old_numlumps);
+
+    // Setup sprite/flat lists
+
+    SetupLists();
+
+    // Generate list of sprites to be replaced by the PWAD
+
+    GenerateSpriteList();
+
+    // Perform the merge
+
+    DoMerge();
+
+    W_GenerateHashTable();
+}
+
+// Replace lumps in the given list with lumps from the PWAD
+
+static void W_NWTAddLumps(searchlist_t *list)
+{
+    keyhash_t pwad_hash;
+    int i;
+
+    HashList(&pwad_hash, &pwad);
+
+    // Go through the IWAD list given, replacing lumps with lumps of
+    // the same name from the PWAD
+
+    for (i=0; i<list->numlumps; ++i)
+    {
+        int index;
+
+        index = FindInHash(&pwad_hash, list->lumps[i].key);
+
+        if (index > 0)
+        {
+            memcpy(&list->lumps[i], &pwad.lumps[index],
+                   sizeof(lumpinfo_t));
+        }
+    }
+
+    FreeKeyHash(&pwad_hash);
+}
+
+// Merge sprites and flats in the way NWT does with its -af and -as
+// command-line options.
+
+void W_NWTMergeFile(char *filename, int flags)
+{
+    int old_numlumps;
+
+    old_numlumps = numlumps;
+
+    // Load PWAD
+
+    if (W_AddFile(filename) == NULL)
+        return;
+
+    FlushLumpCache();
+
+    // iwad is at the start, pwad was appended to the end
+
+    SplitDirectory(old_numlumps);
+
+    // Setup sprite/flat lists
+
+    SetupLists();
+
+    // Merge in flats?
+
+    if (flags & W_NWT_MERGE_FLATS)
+    {
+        W_NWTAddLumps(&iwad_flats);
+    }
+
+    // Sprites?
+
+    if (flags & W_NWT_MERGE_SPRITES)
+    {
+        W_NWTAddLumps(&iwad_sprites);
+    }
+
+    // Discard the PWAD
+
+    numlumps = old_numlumps;
+
+    W_GenerateHashTable();
+}
+
+// Simulates the NWT -merge command line parameter.  What this does is load
+// a PWAD, then search the IWAD sprites, removing any sprite lumps that also
+// exist in the PWAD.
+
+void W_NWTDashMerge(char *filename)
+{
+    wad_file_t *wad_file;
+    keyhash_t pwad_hash;
+    int old_numlumps;
+    int i;
+
+    old_numlumps = numlumps;
+
+    // Load PWAD
+
+    wad_file = W_AddFile(filename);
+
+    if (wad_file == NULL)
+    {
+        return;
+    }
+
+    // iwad is at the start, pwad was appended to the end
+
+    SplitDirectory(old_numlumps);
+
+    // Setup sprite/flat lists
+
+    SetupLists();
+
+    // Search through the IWAD sprites list.
+
+    HashList(&pwad_hash, &pwad);
+
+    for (i=0; i<iwad_sprites.numlumps; ++i)
+    {
+        if (FindInHash(&pwad_hash, iwad_sprites.lumps[i].key) >= 0)
+        {
+            // Replace this entry with an empty string.  This is what
+            // nwt -merge does.
+
+            M_StringCopy(iwad_sprites.lumps[i].name, "", 8);
+            iwad_sprites.lumps[i].key = 0;
+        }
+    }
+
+    FreeKeyHash(&pwad_hash);
+
+    // Discard PWAD
+    // The PWAD must now be added in again with -file.
+
+    numlumps = old_numlumps;
+
+    W_CloseFile(wad_file);
+
+    W_GenerateHashTable();
+}
+
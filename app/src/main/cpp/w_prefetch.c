@@ -0,0 +1,442 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Lump access tracing and prefetch plans.
+//
+//     With -lumptrace, every lump read from a WAD file (and the first
+//     cache hit on a lump in each load phase) is written out as a line
+//     of text:
+//
+//         phase lump name position size ms kind
+//
+//     -prefetch reads such a trace back and turns it into a plan for
+//     each phase: the lumps the phase read from disk, sorted by their
+//     place in the file and merged into runs where they are close
+//     together.  When the phase begins again a background thread reads
+//     the runs in order and puts the lumps in the cache, so that the
+//     loading code finds them there instead of seeking about the file
+//     for each one.  Slow random access storage (flash on watches,
+//     compressed APK assets) gains the most.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_timer.h"
+#include "m_argv.h"
+#include "m_misc.h"
+#include "w_prefetch.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+// Lumps closer together than this are read in one go, gap and all.
+#define PREFETCHGAP     (16*1024)
+
+// Runs are kept to this size so the zone is not locked for long.
+#define PREFETCHRUN     (256*1024)
+
+typedef struct
+{
+    char phase[9];
+    int *lumps;
+    int numlumps;
+    int alloced;
+} prefetchplan_t;
+
+static prefetchplan_t *plans;
+static int numplans;
+
+static FILE *tracefile;
+static int tracestart;
+
+// Phase generation in which each lump was last traced, so a lump
+// used every frame is only written out once per phase.
+static int *tracegen;
+static unsigned int numtracegen;
+static int phasegen = 1;
+
+static char curphase[9] = "GAME";
+
+static i_thread_t *prefetchthread;
+static volatile boolean prefetchstop;
+
+static void *GrowArray(void *ptr, size_t size)
+{
+    ptr = realloc(ptr, size);
+
+    if (ptr == NULL)
+        I_Error("W_InitPrefetch: out of memory");
+
+    return ptr;
+}
+
+static prefetchplan_t *FindPlan(char *phase)
+{
+    for (int i = 0; i < numplans; ++i)
+    {
+        if (!strcasecmp(plans[i].phase, phase))
+            return &plans[i];
+    }
+
+    return NULL;
+}
+
+static prefetchplan_t *AddPlan(char *phase)
+{
+    prefetchplan_t *plan;
+
+    plan = FindPlan(phase);
+
+    if (plan != NULL)
+        return plan;
+
+    plans = GrowArray(plans, (numplans + 1) * sizeof(prefetchplan_t));
+    plan = &plans[numplans++];
+    M_StringCopy(plan->phase, phase, sizeof(plan->phase));
+    plan->lumps = NULL;
+    plan->numlumps = 0;
+    plan->alloced = 0;
+
+    return plan;
+}
+
+static void AddPlanLump(prefetchplan_t *plan, int lump)
+{
+    if (plan->numlumps == plan->alloced)
+    {
+        plan->alloced = plan->alloced ? plan->alloced * 2 : 64;
+        plan->lumps = GrowArray(plan->lumps, plan->alloced * sizeof(int));
+    }
+
+    plan->lumps[plan->numlumps++] = lump;
+}
+
+// Order lumps by file, then by position in the file.
+
+static int ComparePlanLumps(const void *a, const void *b)
+{
+    lumpinfo_t *la = &lumpinfo[*(const int *) a];
+    lumpinfo_t *lb = &lumpinfo[*(const int *) b];
+
+    if (la->wad_file != lb->wad_file)
+        return la->wad_file < lb->wad_file ? -1 : 1;
+
+    return la->position - lb->position;
+}
+
+static void SortPlan(prefetchplan_t *plan)
+{
+    int n;
+
+    qsort(plan->lumps, plan->numlumps, sizeof(int), ComparePlanLumps);
+
+    // The same lump may have been read more than once.
+
+    n = 0;
+
+    for (int i = 0; i < plan->numlumps; ++i)
+    {
+        if (n == 0 || plan->lumps[n - 1] != plan->lumps[i])
+            plan->lumps[n++] = plan->lumps[i];
+    }
+
+    plan->numlumps = n;
+}
+
+//
+// Build plans from a trace. Lumps are kept by number, but only where
+// the name, position and size still match, as the trace may have been
+// made with different WADs.
+//
+static void LoadPlans(char *filename)
+{
+    char line[128];
+    char phase[9], name[9];
+    int lump, position, size, ms;
+    char kind;
+    int count;
+    FILE *f;
+
+    f = fopen(filename, "r");
+
+    if (f == NULL)
+    {
+        printf("W_InitPrefetch: Unable to read %s\n", filename);
+        return;
+    }
+
+    count = 0;
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        lumpinfo_t *l;
+
+        if (line[0] == '#')
+            continue;
+
+        if (sscanf(line, "%8s %d %8s %d %d %d %c", phase, &lump, name,
+                   &position, &size, &ms, &kind) != 7
+         || kind != W_TRACE_READ)
+        {
+            continue;
+        }
+
+        if (lump < 0 || (unsigned int) lump >= numlumps)
+            continue;
+
+        l = &lumpinfo[lump];
+
+        if (l->key != W_LumpNameKey(name)
+         || l->position != position || l->size != size
+         || l->wad_file->mapped != NULL)
+        {
+            continue;
+        }
+
+        AddPlanLump(AddPlan(phase), lump);
+        ++count;
+    }
+
+    fclose(f);
+
+    for (int i = 0; i < numplans; ++i)
+        SortPlan(&plans[i]);
+
+    printf("W_InitPrefetch: %i lump reads in %i phases from %s\n",
+           count, numplans, filename);
+}
+
+static void CloseTrace(void)
+{
+    if (tracefile != NULL)
+    {
+        fclose(tracefile);
+        tracefile = NULL;
+    }
+}
+
+void W_InitPrefetch(void)
+{
+    int p;
+
+    //!
+    // @arg <file>
+    // @category obscure
+    //
+    // Write a line to the given file for each lump read from a WAD,
+    // tagged with the load phase it was read in.
+    //
+
+    p = M_CheckParmWithArgs("-lumptrace", 1);
+
+    if (p)
+    {
+        tracefile = fopen(myargv[p + 1], "w");
+
+        if (tracefile == NULL)
+            I_Error("W_InitPrefetch: Unable to open %s", myargv[p + 1]);
+
+        fprintf(tracefile, "# phase lump name position size ms kind\n");
+
+        numtracegen = numlumps;
+        tracegen = GrowArray(NULL, numtracegen * sizeof(int));
+        memset(tracegen, 0, numtracegen * sizeof(int));
+        tracestart = I_GetTimeMS();
+
+        I_AtExit(CloseTrace, true);
+    }
+
+    //!
+    // @arg <file>
+    // @category obscure
+    //
+    // Read ahead the lumps a trace written by -lumptrace shows each
+    // load phase needs, in file order, as the phase begins.
+    //
+
+    p = M_CheckParmWithArgs("-prefetch", 1);
+
+    if (p)
+    {
+        LoadPlans(myargv[p + 1]);
+    }
+}
+
+void W_TraceLump(int lump, int kind)
+{
+    lumpinfo_t *l;
+    char name[9];
+
+    if (tracefile == NULL)
+        return;
+
+    if ((unsigned int) lump < numtracegen)
+    {
+        if (kind == W_TRACE_HIT && tracegen[lump] == phasegen)
+            return;
+
+        tracegen[lump] = phasegen;
+    }
+
+    l = &lumpinfo[lump];
+    memcpy(name, l->name, 8);
+    name[8] = '\0';
+
+    if (name[0] == '\0')
+        M_StringCopy(name, "-", sizeof(name));
+
+    fprintf(tracefile, "%-8s %6i %-8s %10i %8i %8i %c\n",
+            curphase, lump, name, l->position, l->size,
+            I_GetTimeMS() - tracestart, kind);
+}
+
+//
+// Read the lumps of one run, from the first to runend, which is
+// the furthest any of them reaches (lumps may overlap, so that is
+// not always the end of the last), and cache the ones nobody has
+// loaded yet. The cache only takes space that is free,
+// as purging or growing the zone is for the main thread to do;
+// returns false once it is full, or memory runs out.
+//
+static boolean PrefetchRun(int *lumps, int count, int runend,
+                           byte **buffer, int *buffersize)
+{
+    boolean result = true;
+    lumpinfo_t *first = &lumpinfo[lumps[0]];
+    int length;
+
+    length = runend - first->position;
+
+    if (length > *buffersize)
+    {
+        byte *newbuffer = realloc(*buffer, length);
+
+        if (newbuffer == NULL)
+            return false;
+
+        *buffer = newbuffer;
+        *buffersize = length;
+    }
+
+    Z_Lock();
+
+    if (W_Read(first->wad_file, first->position, *buffer, length)
+        == (size_t) length)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            lumpinfo_t *l = &lumpinfo[lumps[i]];
+
+            if (l->cache == NULL)
+            {
+                if (Z_TryMalloc(l->size, PU_CACHE, &l->cache) == NULL)
+                {
+                    result = false;
+                    break;
+                }
+
+                memcpy(l->cache, *buffer + (l->position - first->position),
+                       l->size);
+            }
+        }
+    }
+
+    Z_Unlock();
+
+    return result;
+}
+
+static void PrefetchThread(void *arg)
+{
+    prefetchplan_t *plan = arg;
+    byte *buffer = NULL;
+    int buffersize = 0;
+    int start, end;
+
+    for (start = 0; start < plan->numlumps && !prefetchstop; start = end)
+    {
+        lumpinfo_t *first = &lumpinfo[plan->lumps[start]];
+        int runend = first->position + first->size;
+
+        for (end = start + 1; end < plan->numlumps; ++end)
+        {
+            lumpinfo_t *l = &lumpinfo[plan->lumps[end]];
+
+            if (l->wad_file != first->wad_file
+             || l->position > runend + PREFETCHGAP
+             || l->position + l->size - first->position > PREFETCHRUN)
+            {
+                break;
+            }
+
+            if (l->position + l->size > runend)
+                runend = l->position + l->size;
+        }
+
+        // Out of room; what is left is read when it is needed.
+        if (!PrefetchRun(plan->lumps + start, end - start, runend,
+                         &buffer, &buffersize))
+        {
+            break;
+        }
+    }
+
+    free(buffer);
+}
+
+void W_BeginLoadPhase(char *phase)
+{
+    prefetchplan_t *plan;
+    int i;
+
+    W_EndLoadPhase();
+
+    for (i = 0; i < 8 && phase[i] != '\0'; ++i)
+        curphase[i] = toupper((int) phase[i]);
+
+    curphase[i] = '\0';
+    ++phasegen;
+
+    plan = FindPlan(curphase);
+
+    if (plan != NULL && plan->numlumps > 0)
+    {
+        Z_SetThreaded(true);
+        prefetchstop = false;
+        prefetchthread = I_StartThread(PrefetchThread, plan);
+    }
+}
+
+void W_EndLoadPhase(void)
+{
+    if (prefetchthread != NULL)
+    {
+        // Whatever is left was not needed before the phase ended.
+        prefetchstop = true;
+        I_WaitThread(prefetchthread);
+        prefetchthread = NULL;
+        Z_SetThreaded(false);
+    }
+
+    if (strcmp(curphase, "GAME"))
+    {
+        M_StringCopy(curphase, "GAME", sizeof(curphase));
+        ++phasegen;
+    }
+}
+
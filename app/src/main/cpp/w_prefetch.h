@@ -0,0 +1,44 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//     Lump access tracing, and prefetching of the lumps a load
+//     phase (startup, or a level) read the last time it was traced.
+//
+
+#ifndef W_PREFETCH_H
+#define W_PREFETCH_H
+
+#include "doomtype.h"
+
+// Kinds of lump access in a trace.
+
+#define W_TRACE_READ    'r'     // read from the WAD file
+#define W_TRACE_HIT     'c'     // W_CacheLumpNum found it cached
+
+// Parse -lumptrace and -prefetch. Call once all WADs are loaded,
+// as plans refer to lumps by number.
+void W_InitPrefetch(void);
+
+// A load phase is named by up to eight characters: "STARTUP",
+// or the map lump name. Beginning one starts reading its plan in
+// the background; ending it waits for that to stop.
+void W_BeginLoadPhase(char *phase);
+void W_EndLoadPhase(void);
+
+// Record an access to a lump, if tracing. Called with the zone
+// locked.
+void W_TraceLump(int lump, int kind);
+
+#endif /* #ifndef W_PREFETCH_H */
+
@@ -31,6 +31,7 @@
 #include "m_misc.h"
 #include "z_zone.h"
 
+#include "w_prefetch.h"
 #include "w_wad.h"
 
 typedef struct {
@@ -56,9 +57,20 @@ typedef struct {
 lumpinfo_t *lumpinfo;
 unsigned int numlumps = 0;
 
-// Hash table for fast lookups
+int numlumpreads;
+int lumpreadbytes;
 
-static lumpinfo_t **lumphash;
+// The lump directory: an open addressing hash table from name keys
+// to lump numbers, kept up to date as WADs are added. Where names
+// repeat it holds the last lump, so PWADs override the IWAD.
+
+typedef struct {
+    uint64_t key;
+    int lump;   // -1 if the slot is empty
+} lumpdirentry_t;
+
+static lumpdirentry_t *lumpdir;
+static unsigned int lumpdirbits;
 
 // Hash function used for lump names.
 unsigned int W_LumpNameHash(const char *s)
@@ -73,6 +85,39 @@ unsigned int W_LumpNameHash(const char *s)
     return result;
 }
 
+// Lump names are up to eight characters and compared without regard
+// to case, so each one packs into an integer, a character per byte.
+uint64_t W_LumpNameKey(const char *s)
+{
+    uint64_t result = 0;
+
+    for (unsigned int i = 0; i < 8 && s[i] != '\0'; ++i)
+        result |= (uint64_t) toupper((int)(unsigned char) s[i]) << (i * 8);
+
+    return result;
+}
+
+static unsigned int LumpDirSlot(uint64_t key)
+{
+    // Fibonacci hashing: the top bits of the product are well mixed.
+    return (unsigned int) ((key * 0x9E3779B97F4A7C15ULL) >> (64 - lumpdirbits));
+}
+
+// Enter a lump in the directory. Lumps are added in order, so one
+// with a name already present replaces it.
+static void AddToLumpDir(int lump)
+{
+    uint64_t key = lumpinfo[lump].key;
+    unsigned int mask = (1u << lumpdirbits) - 1;
+    unsigned int slot = LumpDirSlot(key);
+
+    while (lumpdir[slot].lump != -1 && lumpdir[slot].key != key)
+        slot = (slot + 1) & mask;
+
+    lumpdir[slot].key = key;
+    lumpdir[slot].lump = lump;
+}
+
 // Increase the size of the lumpinfo[] array to the specified size.
 static void ExtendLumpInfo(int newnumlumps)
 {
@@ -92,14 +137,6 @@ static void ExtendLumpInfo(int newnumlumps)
         {
             Z_ChangeUser(newlumpinfo[i].cache, &newlumpinfo[i].cache);
         }
-
-        // We shouldn't be generating a hash table until after all WADs have
-        // been loaded, but just in case...
-        if (lumpinfo[i].next != NULL)
-        {
-            int nextlumpnum = lumpinfo[i].next - lumpinfo;
-            newlumpinfo[i].next = &newlumpinfo[nextlumpnum];
-        }
     }
 
     // All done.
@@ -200,6 +237,7 @@ wad_file_t *W_AddFile(char *filename)
         lump_p->size = LONG(filerover->size);
         lump_p->cache = NULL;
         strncpy(lump_p->name, filerover->name, 8);
+        lump_p->key = W_LumpNameKey(lump_p->name);
 
         ++lump_p;
         ++filerover;
@@ -207,49 +245,48 @@ wad_file_t *W_AddFile(char *filename)
 
     Z_Free(fileinfo);
 
-    if (lumphash != NULL)
+    // Keep the directory at most half full.
+    if (lumpdir == NULL || numlumps * 2 > (1u << lumpdirbits))
+    {
+        W_GenerateHashTable();
+    }
+    else
     {
-        Z_Free(lumphash);
-        lumphash = NULL;
+        for (unsigned int i = startlump; i < numlumps; ++i)
+            AddToLumpDir(i);
     }
 
     return wad_file;
 }
 
-// Returns -1 if name not found.
-int W_CheckNumForName(char *name)
+// Returns -1 if no lump has the given name key.
+int W_CheckNumForKey(uint64_t key)
 {
-    // Do we have a hash table yet?
-    if (lumphash != NULL)
-    {
-        // We do! Excellent.
-        int hash = W_LumpNameHash(name) % numlumps;
+    unsigned int mask;
+    unsigned int slot;
 
-        for (lumpinfo_t *lump_p = lumphash[hash]; lump_p != NULL; lump_p = lump_p->next)
-        {
-            if (!strncasecmp(lump_p->name, name, 8))
-            {
-                return lump_p - lumpinfo;
-            }
-        }
-    }
-    else
-    {
-        // We don't have a hash table generate yet. Linear search :-(
-        //
-        // scan backwards so patch lump files take precedence
+    if (lumpdir == NULL)
+        return -1;
 
-        for (int i = numlumps-1; i >= 0; --i)
-        {
-            if (!strncasecmp(lumpinfo[i].name, name, 8))
-                return i;
-        }
+    mask = (1u << lumpdirbits) - 1;
+
+    for (slot = LumpDirSlot(key); lumpdir[slot].lump != -1;
+         slot = (slot + 1) & mask)
+    {
+        if (lumpdir[slot].key == key)
+            return lumpdir[slot].lump;
     }
 
     // TFB. Not found.
     return -1;
 }
 
+// Returns -1 if name not found.
+int W_CheckNumForName(char *name)
+{
+    return W_CheckNumForKey(W_LumpNameKey(name));
+}
+
 // Calls W_CheckNumForName, but bombs out if not found.
 int W_GetNumForName(char *name)
 {
@@ -283,7 +320,14 @@ void W_ReadLump(unsigned int lump, void *dest)
 
     lumpinfo_t *l = lumpinfo+lump;
 
+    // The read is made under the zone lock, so threads loading
+    // lumps at the same time read them one after another.
+    Z_Lock();
     int c = W_Read(l->wad_file, l->position, dest, l->size);
+    W_TraceLump(lump, W_TRACE_READ);
+    ++numlumpreads;
+    lumpreadbytes += c;
+    Z_Unlock();
 
     if (c < l->size)
     {
@@ -316,6 +360,8 @@ void *W_CacheLumpNum(int lumpnum, int tag)
 
     lump = &lumpinfo[lumpnum];
 
+    Z_Lock();
+
     // Get the pointer to return.  If the lump is in a memory-mapped
     // file, we can just return a pointer to within the memory-mapped
     // region.  If the lump is in an ordinary file, we may already
@@ -326,6 +372,7 @@ void *W_CacheLumpNum(int lumpnum, int tag)
         // Memory mapped file, return from the mmapped region.
 
         result = lump->wad_file->mapped + lump->position;
+        W_TraceLump(lumpnum, W_TRACE_HIT);
     }
     else if (lump->cache != NULL)
     {
@@ -333,6 +380,7 @@ void *W_CacheLumpNum(int lumpnum, int tag)
 
         result = lump->cache;
         Z_ChangeTag(lump->cache, tag);
+        W_TraceLump(lumpnum, W_TRACE_HIT);
     }
     else
     {
@@ -343,6 +391,8 @@ void *W_CacheLumpNum(int lumpnum, int tag)
         result = lump->cache;
     }
 
+    Z_Unlock();
+
     return result;
 }
 
@@ -378,7 +428,9 @@ void W_ReleaseLumpNum(int lumpnum)
     }
     else
     {
+        Z_Lock();
         Z_ChangeTag(lump->cache, PU_CACHE);
+        Z_Unlock();
     }
 }
 
@@ -387,29 +439,29 @@ void W_ReleaseLumpName(char *name)
     W_ReleaseLumpNum(W_GetNumForName(name));
 }
 
-// Generate a hash table for fast lookups
+// (Re)build the lump directory, a quarter full so that W_AddFile
+// can add to it for a while before it has to be rebuilt.
 void W_GenerateHashTable(void)
 {
-    // Free the old hash table, if there is one
-    if (lumphash != NULL)
-        Z_Free(lumphash);
+    unsigned int size;
 
-    // Generate hash table
-    if (numlumps > 0)
-    {
-        lumphash = Z_Malloc(sizeof(lumpinfo_t *) * numlumps, PU_STATIC, NULL);
-        memset(lumphash, 0, sizeof(lumpinfo_t *) * numlumps);
+    // Free the old directory, if there is one
+    if (lumpdir != NULL)
+        Z_Free(lumpdir);
 
-        for (unsigned int i = 0; i < numlumps; ++i)
-        {
-            unsigned int hash = W_LumpNameHash(lumpinfo[i].name) % numlumps;
+    lumpdirbits = 6;
 
-            // Hook into the hash table
+    while ((1u << lumpdirbits) < numlumps * 4)
+        ++lumpdirbits;
 
-            lumpinfo[i].next = lumphash[hash];
-            lumphash[hash] = &lumpinfo[i];
-        }
-    }
+    size = 1u << lumpdirbits;
+    lumpdir = Z_Malloc(sizeof(lumpdirentry_t) * size, PU_STATIC, NULL);
+
+    for (unsigned int i = 0; i < size; ++i)
+        lumpdir[i].lump = -1;
+
+    for (unsigned int i = 0; i < numlumps; ++i)
+        AddToLumpDir(i);
 
     // All done!
 }
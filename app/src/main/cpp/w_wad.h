@@ -37,14 +37,18 @@ typedef struct lumpinfo_s {
     int size;
     void *cache;
 
-    // Used for hash table lookups
-    struct lumpinfo_s *next;
+    // The name in upper case, packed into an integer (W_LumpNameKey)
+    uint64_t key;
 } lumpinfo_t;
 
 
 extern lumpinfo_t *lumpinfo;
 extern unsigned int numlumps;
 
+// Lumps read from their files so far, and the bytes read.
+extern int numlumpreads;
+extern int lumpreadbytes;
+
 wad_file_t *W_AddFile(char *filename);
 
 int W_CheckNumForName(char *name);
@@ -59,6 +63,8 @@ void *W_CacheLumpName(char *name, int tag);
 void W_GenerateHashTable(void);
 
 extern unsigned int W_LumpNameHash(const char *s);
+extern uint64_t W_LumpNameKey(const char *s);
+int W_CheckNumForKey(uint64_t key);
 
 void W_ReleaseLumpNum(int lump);
 void W_ReleaseLumpName(char *name);
@@ -17,8 +17,12 @@
 //
 
 
+#include <stdlib.h>
+#include <signal.h>
+
 #include "z_zone.h"
 #include "i_system.h"
+#include "i_timer.h"
 #include "doomtype.h"
 
 
@@ -31,6 +35,11 @@
 //
 // It is of no value to free a cachable block,
 //  because it will get overwritten automatically if needed.
+//
+// The zone is a list of chunks. The first comes from I_ZoneBase and
+//  is kept for the whole run; when no chunk has room for a block even
+//  after purging the cache, another chunk is malloced, up to the
+//  total given by I_ZoneMaxSize. Z_Trim gives empty chunks back.
 // 
  
 #define MEM_ALIGN sizeof(void *)
@@ -39,6 +48,7 @@
 typedef struct memblock_s
 {
     int			size;	// including the header and possibly tiny fragments
+    int			site;	// telemetry call site, or -1
     void**		user;
     int			tag;	// PU_FREE if this is free
     int			id;	// should be ZONEID
@@ -47,7 +57,7 @@ typedef struct memblock_s
 } memblock_t;
 
 
-typedef struct
+typedef struct memzone_s
 {
     // total bytes malloced, including header
     int		size;
@@ -56,6 +66,9 @@ typedef struct
     memblock_t	blocklist;
     
     memblock_t*	rover;
+
+    // next chunk of the zone
+    struct memzone_s*	next;
     
 } memzone_t;
 
@@ -63,6 +76,117 @@ typedef struct
 
 memzone_t*	mainzone;
 
+// chunk the next allocation is tried in first
+static memzone_t*	alloczone;
+
+// bytes in all chunks, and the most they may grow to
+static int		zonetotal;
+static int		zonemax;
+
+#define ZONE_GROWSIZE		(2*1024*1024)
+
+// trim requested by Z_RequestTrim, run by Z_CheckTrim
+static volatile sig_atomic_t	trimrequest;
+
+// slabs with live pages, reset by Z_FreeTags
+static zslab_t*	slabs;
+
+
+//
+// LEVEL ARENA
+// Level data (map geometry and the thinker slabs) is bump allocated
+//  in load order from chunks kept outside the zone, so it does not
+//  fragment the cache blocks, and Z_FreeTags releases it in one step
+//  when it frees PU_LEVEL. Chunks are kept for the next level; a
+//  chunk's used count is only cleared when the bump pointer reaches it.
+//
+#define ARENA_CHUNKSIZE		(256*1024)
+#define ARENA_HEADER		((sizeof(arenachunk_t) + 15) & ~15)
+
+typedef struct arenachunk_s
+{
+    struct arenachunk_s*	next;
+    int				size;	// usable bytes after the header
+    int				used;
+} arenachunk_t;
+
+static arenachunk_t*	arenachunks;
+static arenachunk_t*	arenacurrent;
+
+
+//
+// TELEMETRY
+// Started with -zonestats. Every block remembers the Z_Malloc call
+//  site that allocated it, bytes and counts are kept per tag and per
+//  call site, purges of cache blocks are counted, and the largest free
+//  block is sampled over time. Z_WriteTelemetry writes all of it, with
+//  a map of every block in the zone, as JSON for offline analysis.
+//
+#define MAXSITES		512
+#define MAXSAMPLES		4096
+
+typedef struct
+{
+    char*	file;
+    int		line;
+    int		count;		// live blocks
+    int		bytes;		// live bytes, headers included
+    int		peakbytes;
+    int		allocs;		// blocks ever allocated
+} zsite_t;
+
+typedef struct
+{
+    int		time;		// ms
+    int		largestfree;
+    int		freebytes;
+    int		purges;
+} zsample_t;
+
+static boolean		telemetry = false;
+static char*		telemetry_file;
+static zsite_t		sites[MAXSITES];
+static int		numsites;
+static int		tagbytes[PU_NUM_TAGS];
+static int		tagcount[PU_NUM_TAGS];
+static int		purges;
+static int		purgedbytes;
+static zsample_t	samples[MAXSAMPLES];
+static int		numsamples;
+
+static i_mutex_t*	zonelock;
+static int		zonethreaded = 0;
+
+
+
+//
+// Z_SetThreaded
+// Calls nest, so each user of the zone from another thread
+// can turn locking on and off around its own work. Only the
+// outermost call may be made with no other thread in the zone.
+//
+void Z_SetThreaded (boolean threaded)
+{
+    if (threaded && zonelock == NULL)
+        zonelock = I_CreateMutex ();
+
+    if (threaded)
+        zonethreaded++;
+    else if (zonethreaded > 0)
+        zonethreaded--;
+}
+
+void Z_Lock (void)
+{
+    if (zonethreaded)
+        I_LockMutex (zonelock);
+}
+
+void Z_Unlock (void)
+{
+    if (zonethreaded)
+        I_UnlockMutex (zonelock);
+}
 
 
 //
@@ -85,8 +209,11 @@ void Z_ClearZone (memzone_t* zone)
     
     // a free block.
     block->tag = PU_FREE;
+    block->site = -1;
 
     block->size = zone->size - sizeof(memzone_t);
+
+    zone->next = NULL;
 }
 
 
@@ -115,8 +242,282 @@ void Z_Init (void)
 
     // free block
     block->tag = PU_FREE;
+    block->site = -1;
     
     block->size = mainzone->size - sizeof(memzone_t);
+
+    mainzone->next = NULL;
+    alloczone = mainzone;
+    zonetotal = size;
+    zonemax = I_ZoneMaxSize ();
+
+    if (zonemax < zonetotal)
+        zonemax = zonetotal;
+}
+
+
+//
+// Z_AddZone
+// Appends a chunk with room for a block of the given size, or
+//  returns NULL if that would take the zone past its limit.
+//
+static memzone_t *Z_AddZone (int size)
+{
+    memzone_t*	zone;
+    memzone_t*	last;
+    int		chunksize;
+
+    chunksize = size + sizeof(memzone_t);
+
+    if (chunksize > zonemax - zonetotal)
+        return NULL;
+
+    if (chunksize < ZONE_GROWSIZE)
+    {
+        chunksize = ZONE_GROWSIZE;
+
+        if (chunksize > zonemax - zonetotal)
+            chunksize = zonemax - zonetotal;
+    }
+
+    zone = malloc (chunksize);
+
+    if (zone == NULL)
+        return NULL;
+
+    zone->size = chunksize;
+    Z_ClearZone (zone);
+
+    for (last = mainzone ; last->next != NULL ; last = last->next)
+        ;
+
+    last->next = zone;
+    zonetotal += chunksize;
+
+    return zone;
+}
+
+
+//
+// Z_BlockZone
+// The chunk a block lives in.
+//
+static memzone_t *Z_BlockZone (memblock_t *block)
+{
+    memzone_t*	zone;
+    uintptr_t	addr;
+
+    addr = (uintptr_t) block;
+
+    for (zone = mainzone ; zone != NULL ; zone = zone->next)
+    {
+        if (addr > (uintptr_t) zone && addr < (uintptr_t) zone + zone->size)
+            return zone;
+    }
+
+    I_Error ("Z_BlockZone: block %p is not in the zone", block);
+
+    return NULL;
+}
+
+
+//
+// Z_SiteIndex
+// Finds or adds the entry for a call site.
+//
+static int Z_SiteIndex (char *file, int line)
+{
+    unsigned int	hash;
+    int			i;
+
+    hash = ((unsigned int) (uintptr_t) file >> 2) * 31 + line;
+
+    for (i = hash % MAXSITES ; ; i = (i + 1) % MAXSITES)
+    {
+        if (sites[i].file == file && sites[i].line == line)
+            return i;
+
+        if (sites[i].file == NULL)
+        {
+            if (numsites == MAXSITES - 1)
+                return -1;
+
+            ++numsites;
+            sites[i].file = file;
+            sites[i].line = line;
+            return i;
+        }
+    }
+}
+
+
+//
+// Z_Account
+// Adds (dir 1) or removes (dir -1) a block from the statistics.
+//
+static void Z_Account (memblock_t *block, int dir)
+{
+    zsite_t*	site;
+
+    tagbytes[block->tag] += dir * block->size;
+    tagcount[block->tag] += dir;
+
+    if (block->site < 0)
+        return;
+
+    site = &sites[block->site];
+    site->bytes += dir * block->size;
+    site->count += dir;
+
+    if (dir > 0)
+    {
+        ++site->allocs;
+
+        if (site->bytes > site->peakbytes)
+            site->peakbytes = site->bytes;
+    }
+}
+
+
+//
+// Z_StartTelemetry
+// Begin recording; the results are written to the given file on exit.
+//
+void Z_StartTelemetry (char *filename)
+{
+    telemetry = true;
+    telemetry_file = filename;
+
+    I_AtExit (Z_WriteTelemetry, true);
+}
+
+
+//
+// Z_TelemetrySample
+// Records the largest free block and free total at this moment.
+//
+void Z_TelemetrySample (void)
+{
+    memzone_t*	zone;
+    memblock_t*	block;
+    zsample_t*	sample;
+
+    if (!telemetry || numsamples == MAXSAMPLES)
+        return;
+
+    sample = &samples[numsamples++];
+    sample->time = I_GetTimeMS ();
+    sample->largestfree = 0;
+    sample->freebytes = 0;
+    sample->purges = purges;
+
+    for (zone = mainzone ; zone != NULL ; zone = zone->next)
+    {
+        for (block = zone->blocklist.next ;
+             block != &zone->blocklist;
+             block = block->next)
+        {
+            if (block->tag == PU_FREE)
+            {
+                sample->freebytes += block->size;
+
+                if (block->size > sample->largestfree)
+                    sample->largestfree = block->size;
+            }
+        }
+    }
+}
+
+
+static void Z_WriteString (FILE *f, const char *str)
+{
+    fputc ('"', f);
+
+    for (; *str != '\0' ; ++str)
+    {
+        if (*str == '"' || *str == '\\')
+            fputc ('\\', f);
+
+        fputc (*str, f);
+    }
+
+    fputc ('"', f);
+}
+
+
+//
+// Z_WriteTelemetry
+//
+void Z_WriteTelemetry (void)
+{
+    memzone_t*	zone;
+    memblock_t*	block;
+    FILE*	f;
+    int		i;
+    boolean	first;
+
+    if (!telemetry)
+        return;
+
+    f = fopen (telemetry_file, "w");
+
+    if (f == NULL)
+        return;
+
+    fprintf (f, "{\n\"zonesize\": %i,\n", zonetotal);
+    fprintf (f, "\"purges\": %i,\n\"purgedbytes\": %i,\n",
+             purges, purgedbytes);
+
+    fprintf (f, "\"tags\": [");
+    for (i = PU_STATIC ; i < PU_NUM_TAGS ; ++i)
+    {
+        fprintf (f, "%s\n  {\"tag\": %i, \"count\": %i, \"bytes\": %i}",
+                 i == PU_STATIC ? "" : ",", i, tagcount[i], tagbytes[i]);
+    }
+
+    fprintf (f, "\n],\n\"sites\": [");
+    first = true;
+    for (i = 0 ; i < MAXSITES ; ++i)
+    {
+        if (sites[i].file == NULL)
+            continue;
+
+        fprintf (f, "%s\n  {\"id\": %i, \"file\": ", first ? "" : ",", i);
+        Z_WriteString (f, sites[i].file);
+        fprintf (f, ", \"line\": %i, \"count\": %i, \"bytes\": %i, "
+                    "\"peakbytes\": %i, \"allocs\": %i}",
+                 sites[i].line, sites[i].count, sites[i].bytes,
+                 sites[i].peakbytes, sites[i].allocs);
+        first = false;
+    }
+
+    fprintf (f, "\n],\n\"samples\": [");
+    for (i = 0 ; i < numsamples ; ++i)
+    {
+        fprintf (f, "%s\n  {\"time\": %i, \"largestfree\": %i, "
+                    "\"free\": %i, \"purges\": %i}",
+                 i == 0 ? "" : ",", samples[i].time, samples[i].largestfree,
+                 samples[i].freebytes, samples[i].purges);
+    }
+
+    // heap map: [chunk, offset, size, tag, site] for every block in order
+    fprintf (f, "\n],\n\"blocks\": [");
+    first = true;
+    for (zone = mainzone, i = 0 ; zone != NULL ; zone = zone->next, ++i)
+    {
+        for (block = zone->blocklist.next ;
+             block != &zone->blocklist;
+             block = block->next)
+        {
+            fprintf (f, "%s\n  [%i, %i, %i, %i, %i]", first ? "" : ",", i,
+                     (int) ((byte *) block - (byte *) zone),
+                     block->size, block->tag, block->site);
+            first = false;
+        }
+    }
+
+    fprintf (f, "\n]\n}\n");
+    fclose (f);
 }
 
 
@@ -125,13 +526,22 @@ void Z_Init (void)
 //
 void Z_Free (void* ptr)
 {
+    memzone_t*		zone;
     memblock_t*		block;
     memblock_t*		other;
 	
+    Z_Lock ();
+
     block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
 
     if (block->id != ZONEID)
 	I_Error ("Z_Free: freed a pointer without ZONEID");
+
+    if (telemetry && block->site >= 0)
+    {
+        Z_Account (block, -1);
+        block->site = -1;
+    }
 		
     if (block->tag != PU_FREE && block->user != NULL)
     {
@@ -153,8 +563,10 @@ void Z_Free (void* ptr)
         other->next = block->next;
         other->next->prev = other;
 
-        if (block == mainzone->rover)
-            mainzone->rover = other;
+        zone = Z_BlockZone (block);
+
+        if (block == zone->rover)
+            zone->rover = other;
 
         block = other;
     }
@@ -167,46 +579,31 @@ void Z_Free (void* ptr)
         block->next = other->next;
         block->next->prev = block;
 
-        if (other == mainzone->rover)
-            mainzone->rover = block;
+        zone = Z_BlockZone (block);
+
+        if (other == zone->rover)
+            zone->rover = block;
     }
+
+    Z_Unlock ();
 }
 
 
 
 //
-// Z_Malloc
-// You can pass a NULL user if the tag is < PU_PURGELEVEL.
+// Z_FindBlock
+// Scans a chunk for a free block of at least size bytes, throwing
+//  out purgable blocks along the way if purge is set.
 //
-#define MINFRAGMENT		64
-
-
-void*
-Z_Malloc
-( int		size,
-  int		tag,
-  void*		user )
+static memblock_t *Z_FindBlock (memzone_t *zone, int size, boolean purge)
 {
-    int		extra;
     memblock_t*	start;
     memblock_t* rover;
-    memblock_t* newblock;
     memblock_t*	base;
-    void *result;
 
-    size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
-    
-    // scan through the block list,
-    // looking for the first free block
-    // of sufficient size,
-    // throwing out any purgable blocks along the way.
-
-    // account for size of block header
-    size += sizeof(memblock_t);
-    
     // if there is a free block behind the rover,
     //  back up over them
-    base = mainzone->rover;
+    base = zone->rover;
     
     if (base->prev->tag == PU_FREE)
         base = base->prev;
@@ -219,12 +616,12 @@ Z_Malloc
         if (rover == start)
         {
             // scanned all the way around the list
-            I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
+            return NULL;
         }
 	
         if (rover->tag != PU_FREE)
         {
-            if (rover->tag < PU_PURGELEVEL)
+            if (rover->tag < PU_PURGELEVEL || !purge)
             {
                 // hit a block that can't be purged,
                 // so move base past it
@@ -235,6 +632,12 @@ Z_Malloc
                 // free the rover block (adding the size to base)
 
                 // the rover can be the base block
+                if (telemetry)
+                {
+                    ++purges;
+                    purgedbytes += rover->size;
+                }
+
                 base = base->prev;
                 Z_Free ((byte *)rover+sizeof(memblock_t));
                 base = base->next;
@@ -248,6 +651,89 @@ Z_Malloc
 
     } while (base->tag != PU_FREE || base->size < size);
 
+    return base;
+}
+
+
+//
+// Z_Malloc
+// You can pass a NULL user if the tag is < PU_PURGELEVEL.
+// If fromfree is set, only space already free is used: nothing is
+//  purged, the zone is not grown, and NULL is returned when there is
+//  no room.
+//
+#define MINFRAGMENT		64
+
+
+static void*
+Z_Alloc
+( int		size,
+  int		tag,
+  void*		user,
+  boolean	fromfree,
+  char*		file,
+  int		line )
+{
+    int		extra;
+    memzone_t*	zone;
+    memblock_t* newblock;
+    memblock_t*	base;
+    void *result;
+
+    size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
+    
+    // account for size of block header
+    size += sizeof(memblock_t);
+
+    Z_Lock ();
+
+    // look for a free block in every chunk, starting with the
+    // one that satisfied the last allocation; then throw out
+    // purgable blocks; only grow the zone when that fails, so the
+    // cache stays the size it was before the zone could grow.
+    base = NULL;
+    zone = alloczone;
+
+    do
+    {
+        base = Z_FindBlock (zone, size, false);
+
+        if (base == NULL)
+            zone = zone->next != NULL ? zone->next : mainzone;
+
+    } while (base == NULL && zone != alloczone);
+
+    if (base == NULL && fromfree)
+    {
+        Z_Unlock ();
+        return NULL;
+    }
+
+    // Threads hold the lumps they are using as PU_STATIC until
+    // they release them, so purging is safe while threaded too.
+    if (base == NULL)
+    {
+        for (zone = mainzone ; zone != NULL ; zone = zone->next)
+        {
+            base = Z_FindBlock (zone, size, true);
+
+            if (base != NULL)
+                break;
+        }
+    }
+
+    if (base == NULL)
+    {
+        zone = Z_AddZone (size);
+
+        if (zone != NULL)
+            base = Z_FindBlock (zone, size, false);
+    }
+
+    if (base == NULL)
+        I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
+
+    alloczone = zone;
     
     // found a block big enough
     extra = base->size - size;
@@ -259,6 +745,7 @@ Z_Malloc
         newblock->size = extra;
 	
         newblock->tag = PU_FREE;
+        newblock->site = -1;
         newblock->user = NULL;	
         newblock->prev = base;
         newblock->next = base->next;
@@ -282,13 +769,211 @@ Z_Malloc
     }
 
     // next allocation will start looking here
-    mainzone->rover = base->next;	
+    zone->rover = base->next;	
 	
     base->id = ZONEID;
+
+    if (telemetry)
+    {
+        base->site = Z_SiteIndex (file, line);
+        Z_Account (base, 1);
+    }
+    else
+    {
+        base->site = -1;
+    }
+
+    Z_Unlock ();
     
     return result;
 }
 
+void*
+Z_Malloc2
+( int		size,
+  int		tag,
+  void*		user,
+  char*		file,
+  int		line )
+{
+    return Z_Alloc (size, tag, user, false, file, line);
+}
+
+//
+// Z_TryMalloc
+// For a thread filling the cache behind the main thread's back:
+//  the cache the main thread may be using is left alone, and
+//  running out of room is not an error.
+//
+void*
+Z_TryMalloc2
+( int		size,
+  int		tag,
+  void*		user,
+  char*		file,
+  int		line )
+{
+    return Z_Alloc (size, tag, user, true, file, line);
+}
+
+
+
+//
+// Z_LevelAlloc
+// Memory that lives until the level is exited.
+//
+void *Z_LevelAlloc (int size)
+{
+    arenachunk_t*	chunk;
+    arenachunk_t**	link;
+    void*		result;
+
+    size = (size + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1);
+
+    chunk = arenacurrent;
+
+    while (chunk == NULL || chunk->used + size > chunk->size)
+    {
+        // move on to the next kept chunk that is large enough,
+        // or add a new one after the current chunk
+        link = chunk != NULL ? &chunk->next : &arenachunks;
+
+        while (*link != NULL && (*link)->size < size)
+            link = &(*link)->next;
+
+        if (*link == NULL)
+        {
+            int chunksize = size > ARENA_CHUNKSIZE ? size : ARENA_CHUNKSIZE;
+
+            *link = malloc (ARENA_HEADER + chunksize);
+
+            if (*link == NULL)
+                I_Error ("Z_LevelAlloc: failed on allocation of %i bytes",
+                         size);
+
+            (*link)->next = NULL;
+            (*link)->size = chunksize;
+        }
+
+        chunk = *link;
+        chunk->used = 0;
+    }
+
+    arenacurrent = chunk;
+    result = (byte *) chunk + ARENA_HEADER + chunk->used;
+    chunk->used += size;
+
+    return result;
+}
+
+
+//
+// Z_ResetLevelArena
+//
+static void Z_ResetLevelArena (void)
+{
+    arenacurrent = arenachunks;
+
+    if (arenacurrent != NULL)
+        arenacurrent->used = 0;
+}
+
+
+//
+// Z_SlabAlloc
+// Objects are SLAB_ALIGN aligned, each preceded by a pointer back
+//  to its slab so that Z_SlabFree needs nothing else.
+//
+#define SLAB_ALIGN		64
+#define SLAB_PAGEOBJECTS	32
+
+void *Z_SlabAlloc (zslab_t *slab)
+{
+    byte*	page;
+    void*	result;
+    int		size;
+
+    if (!slab->registered)
+    {
+        slab->stride = (slab->size + sizeof(zslab_t *) + SLAB_ALIGN - 1)
+                     & ~(SLAB_ALIGN - 1);
+        slab->next = slabs;
+        slabs = slab;
+        slab->registered = true;
+    }
+
+    if (slab->freelist != NULL)
+    {
+        result = slab->freelist;
+        slab->freelist = *(void **) result;
+        return result;
+    }
+
+    if (slab->bump == slab->bumpend)
+    {
+        size = SLAB_ALIGN + sizeof(zslab_t *) + SLAB_PAGEOBJECTS * slab->stride;
+
+        if (slab->tag >= PU_LEVEL && slab->tag < PU_PURGELEVEL)
+            page = Z_LevelAlloc (size);
+        else
+            page = Z_Malloc (size, slab->tag, NULL);
+
+        // leave room for the first object's slab pointer
+        page += sizeof(zslab_t *);
+        slab->bump = (byte *) (((uintptr_t) page + SLAB_ALIGN - 1)
+                               & ~(uintptr_t) (SLAB_ALIGN - 1));
+        slab->bumpend = slab->bump + SLAB_PAGEOBJECTS * slab->stride;
+    }
+
+    result = slab->bump;
+    ((zslab_t **) result)[-1] = slab;
+    slab->bump += slab->stride;
+
+    return result;
+}
+
+
+//
+// Z_SlabFree
+//
+void Z_SlabFree (void *ptr)
+{
+    zslab_t*	slab;
+
+    slab = ((zslab_t **) ptr)[-1];
+
+    *(void **) ptr = slab->freelist;
+    slab->freelist = ptr;
+}
+
+
+//
+// Z_SlabOf
+// The slab an object came from.
+//
+zslab_t *Z_SlabOf (void *ptr)
+{
+    return ((zslab_t **) ptr)[-1];
+}
+
+
+//
+// Z_ResetSlabs
+// The pages of slabs with tags in the range have just been freed.
+//
+static void Z_ResetSlabs (int lowtag, int hightag)
+{
+    zslab_t*	slab;
+
+    for (slab = slabs ; slab != NULL ; slab = slab->next)
+    {
+        if (slab->tag >= lowtag && slab->tag <= hightag)
+        {
+            slab->freelist = NULL;
+            slab->bump = slab->bumpend = NULL;
+        }
+    }
+}
 
 
 //
@@ -299,23 +984,34 @@ Z_FreeTags
 ( int		lowtag,
   int		hightag )
 {
+    memzone_t*	zone;
     memblock_t*	block;
     memblock_t*	next;
 	
-    for (block = mainzone->blocklist.next ;
-	 block != &mainzone->blocklist ;
-	 block = next)
+    for (zone = mainzone ; zone != NULL ; zone = zone->next)
     {
-	// get link before freeing
-	next = block->next;
+	for (block = zone->blocklist.next ;
+	     block != &zone->blocklist ;
+	     block = next)
+	{
+	    // get link before freeing
+	    next = block->next;
 
-	// free block?
-	if (block->tag == PU_FREE)
-	    continue;
+	    // free block?
+	    if (block->tag == PU_FREE)
+		continue;
 	
-	if (block->tag >= lowtag && block->tag <= hightag)
-	    Z_Free ( (byte *)block+sizeof(memblock_t));
+	    if (block->tag >= lowtag && block->tag <= hightag)
+		Z_Free ( (byte *)block+sizeof(memblock_t));
+	}
     }
+
+    Z_ResetSlabs (lowtag, hightag);
+
+    if (lowtag <= PU_LEVEL && hightag >= PU_LEVEL)
+        Z_ResetLevelArena ();
+
+    Z_TelemetrySample ();
 }
 
 
@@ -329,34 +1025,38 @@ Z_DumpHeap
 ( int		lowtag,
   int		hightag )
 {
+    memzone_t*	zone;
     memblock_t*	block;
 	
-    printf ("zone size: %i  location: %p\n",
-	    mainzone->size,mainzone);
-    
     printf ("tag range: %i to %i\n",
 	    lowtag, hightag);
-	
-    for (block = mainzone->blocklist.next ; ; block = block->next)
+
+    for (zone = mainzone ; zone != NULL ; zone = zone->next)
     {
-	if (block->tag >= lowtag && block->tag <= hightag)
-	    printf ("block:%p    size:%7i    user:%p    tag:%3i\n",
-		    block, block->size, block->user, block->tag);
-		
-	if (block->next == &mainzone->blocklist)
+	printf ("zone size: %i  location: %p\n",
+		zone->size,zone);
+	
+	for (block = zone->blocklist.next ; ; block = block->next)
 	{
-	    // all blocks have been hit
-	    break;
-	}
+	    if (block->tag >= lowtag && block->tag <= hightag)
+		printf ("block:%p    size:%7i    user:%p    tag:%3i\n",
+			block, block->size, block->user, block->tag);
+		
+	    if (block->next == &zone->blocklist)
+	    {
+		// all blocks have been hit
+		break;
+	    }
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
-	    printf ("ERROR: block size does not touch the next block\n");
+	    if ( (byte *)block + block->size != (byte *)block->next)
+		printf ("ERROR: block size does not touch the next block\n");
 
-	if ( block->next->prev != block)
-	    printf ("ERROR: next block doesn't have proper back link\n");
+	    if ( block->next->prev != block)
+		printf ("ERROR: next block doesn't have proper back link\n");
 
-	if (block->tag == PU_FREE && block->next->tag == PU_FREE)
-	    printf ("ERROR: two consecutive free blocks\n");
+	    if (block->tag == PU_FREE && block->next->tag == PU_FREE)
+		printf ("ERROR: two consecutive free blocks\n");
+	}
     }
 }
 
@@ -366,29 +1066,33 @@ Z_DumpHeap
 //
 void Z_FileDumpHeap (FILE* f)
 {
+    memzone_t*	zone;
     memblock_t*	block;
 	
-    fprintf (f,"zone size: %i  location: %p\n",mainzone->size,mainzone);
-	
-    for (block = mainzone->blocklist.next ; ; block = block->next)
+    for (zone = mainzone ; zone != NULL ; zone = zone->next)
     {
-	fprintf (f,"block:%p    size:%7i    user:%p    tag:%3i\n",
-		 block, block->size, block->user, block->tag);
-		
-	if (block->next == &mainzone->blocklist)
+	fprintf (f,"zone size: %i  location: %p\n",zone->size,zone);
+	
+	for (block = zone->blocklist.next ; ; block = block->next)
 	{
-	    // all blocks have been hit
-	    break;
-	}
+	    fprintf (f,"block:%p    size:%7i    user:%p    tag:%3i\n",
+		     block, block->size, block->user, block->tag);
+		
+	    if (block->next == &zone->blocklist)
+	    {
+		// all blocks have been hit
+		break;
+	    }
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
-	    fprintf (f,"ERROR: block size does not touch the next block\n");
+	    if ( (byte *)block + block->size != (byte *)block->next)
+		fprintf (f,"ERROR: block size does not touch the next block\n");
 
-	if ( block->next->prev != block)
-	    fprintf (f,"ERROR: next block doesn't have proper back link\n");
+	    if ( block->next->prev != block)
+		fprintf (f,"ERROR: next block doesn't have proper back link\n");
 
-	if (block->tag == PU_FREE && block->next->tag == PU_FREE)
-	    fprintf (f,"ERROR: two consecutive free blocks\n");
+	    if (block->tag == PU_FREE && block->next->tag == PU_FREE)
+		fprintf (f,"ERROR: two consecutive free blocks\n");
+	}
     }
 }
 
@@ -399,24 +1103,28 @@ void Z_FileDumpHeap (FILE* f)
 //
 void Z_CheckHeap (void)
 {
+    memzone_t*	zone;
     memblock_t*	block;
 	
-    for (block = mainzone->blocklist.next ; ; block = block->next)
+    for (zone = mainzone ; zone != NULL ; zone = zone->next)
     {
-	if (block->next == &mainzone->blocklist)
+	for (block = zone->blocklist.next ; ; block = block->next)
 	{
-	    // all blocks have been hit
-	    break;
-	}
+	    if (block->next == &zone->blocklist)
+	    {
+		// all blocks have been hit
+		break;
+	    }
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
-	    I_Error ("Z_CheckHeap: block size does not touch the next block\n");
+	    if ( (byte *)block + block->size != (byte *)block->next)
+		I_Error ("Z_CheckHeap: block size does not touch the next block\n");
 
-	if ( block->next->prev != block)
-	    I_Error ("Z_CheckHeap: next block doesn't have proper back link\n");
+	    if ( block->next->prev != block)
+		I_Error ("Z_CheckHeap: next block doesn't have proper back link\n");
 
-	if (block->tag == PU_FREE && block->next->tag == PU_FREE)
-	    I_Error ("Z_CheckHeap: two consecutive free blocks\n");
+	    if (block->tag == PU_FREE && block->next->tag == PU_FREE)
+		I_Error ("Z_CheckHeap: two consecutive free blocks\n");
+	}
     }
 }
 
@@ -440,7 +1148,19 @@ void Z_ChangeTag2(void *ptr, int tag, char *file, int line)
         I_Error("%s:%i: Z_ChangeTag: an owner is required "
                 "for purgable blocks", file, line);
 
+    Z_Lock ();
+
+    if (telemetry && block->site >= 0)
+    {
+        tagbytes[block->tag] -= block->size;
+        tagcount[block->tag]--;
+        tagbytes[tag] += block->size;
+        tagcount[tag]++;
+    }
+
     block->tag = tag;
+
+    Z_Unlock ();
 }
 
 void Z_ChangeUser(void *ptr, void **user)
@@ -454,8 +1174,10 @@ void Z_ChangeUser(void *ptr, void **user)
         I_Error("Z_ChangeUser: Tried to change user for invalid block!");
     }
 
+    Z_Lock ();
     block->user = user;
     *user = ptr;
+    Z_Unlock ();
 }
 
 
@@ -465,17 +1187,21 @@ void Z_ChangeUser(void *ptr, void **user)
 //
 int Z_FreeMemory (void)
 {
+    memzone_t*		zone;
     memblock_t*		block;
     int			free;
 	
     free = 0;
     
-    for (block = mainzone->blocklist.next ;
-         block != &mainzone->blocklist;
-         block = block->next)
+    for (zone = mainzone ; zone != NULL ; zone = zone->next)
     {
-        if (block->tag == PU_FREE || block->tag >= PU_PURGELEVEL)
-            free += block->size;
+        for (block = zone->blocklist.next ;
+             block != &zone->blocklist;
+             block = block->next)
+        {
+            if (block->tag == PU_FREE || block->tag >= PU_PURGELEVEL)
+                free += block->size;
+        }
     }
 
     return free;
@@ -483,6 +1209,110 @@ int Z_FreeMemory (void)
 
 unsigned int Z_ZoneSize(void)
 {
-    return mainzone->size;
+    return zonetotal;
+}
+
+
+//
+// Z_Trim
+// Gives memory back to the system. Z_TRIM_RELEASE frees chunks
+//  that hold nothing and level arena chunks past the one in use;
+//  Z_TRIM_PURGE first throws out every purgable block.
+//
+void Z_Trim (int level)
+{
+    memzone_t*		zone;
+    memzone_t**		link;
+    memblock_t*		block;
+    memblock_t*		next;
+    arenachunk_t*	chunk;
+
+    if (level >= Z_TRIM_PURGE)
+    {
+        for (zone = mainzone ; zone != NULL ; zone = zone->next)
+        {
+            for (block = zone->blocklist.next ;
+                 block != &zone->blocklist ;
+                 block = next)
+            {
+                next = block->next;
+
+                if (block->tag >= PU_PURGELEVEL)
+                {
+                    if (telemetry)
+                    {
+                        ++purges;
+                        purgedbytes += block->size;
+                    }
+
+                    Z_Free ((byte *) block + sizeof(memblock_t));
+                }
+            }
+        }
+    }
+
+    // the first chunk is not ours to free
+    link = &mainzone->next;
+
+    while (*link != NULL)
+    {
+        zone = *link;
+        block = zone->blocklist.next;
+
+        if (block->tag == PU_FREE && block->next == &zone->blocklist)
+        {
+            *link = zone->next;
+            zonetotal -= zone->size;
+
+            if (alloczone == zone)
+                alloczone = mainzone;
+
+            free (zone);
+        }
+        else
+        {
+            link = &zone->next;
+        }
+    }
+
+    // arena chunks past the current one are only kept for reuse
+    while (arenacurrent != NULL && arenacurrent->next != NULL)
+    {
+        chunk = arenacurrent->next;
+        arenacurrent->next = chunk->next;
+        free (chunk);
+    }
+
+    Z_TelemetrySample ();
+}
+
+
+//
+// Z_RequestTrim
+// Safe to call from signal handlers and other threads; the trim
+//  itself runs at the next Z_CheckTrim.
+//
+void Z_RequestTrim (int level)
+{
+    if (level > trimrequest)
+        trimrequest = level;
+}
+
+
+//
+// Z_CheckTrim
+// Called from the main loop, where no purgable block is in use.
+//
+void Z_CheckTrim (void)
+{
+    int		level;
+
+    level = trimrequest;
+
+    if (level != 0)
+    {
+        trimrequest = 0;
+        Z_Trim (level);
+    }
 }
 
@@ -26,6 +26,8 @@
 
 #include <stdio.h>
 
+#include "doomtype.h"
+
 //
 // ZONE MEMORY
 // PU - purge tags.
@@ -51,7 +53,8 @@ enum
         
 
 void	Z_Init (void);
-void*	Z_Malloc (int size, int tag, void *ptr);
+void*	Z_Malloc2 (int size, int tag, void *ptr, char *file, int line);
+void*	Z_TryMalloc2 (int size, int tag, void *ptr, char *file, int line);
 void    Z_Free (void *ptr);
 void    Z_FreeTags (int lowtag, int hightag);
 void    Z_DumpHeap (int lowtag, int hightag);
@@ -62,12 +65,82 @@ void    Z_ChangeUser(void *ptr, void **user);
 int     Z_FreeMemory (void);
 unsigned int Z_ZoneSize(void);
 
+void    Z_StartTelemetry (char *filename);
+void    Z_TelemetrySample (void);
+void    Z_WriteTelemetry (void);
+
+//
+// Giving memory back to the system when it runs low.
+//
+enum
+{
+    Z_TRIM_RELEASE = 1,             // free empty chunks
+    Z_TRIM_PURGE                    // purge the cache first
+};
+
+void    Z_Trim (int level);
+void    Z_RequestTrim (int level);
+void    Z_CheckTrim (void);
+
+//
+// While other threads may allocate (parallel startup), the zone
+// and the WAD cache on top of it are serialized through one lock.
+// The cache is still purged, so code that may run then must load
+// lumps PU_STATIC and release them, not rely on PU_CACHE.
+//
+void    Z_SetThreaded (boolean threaded);
+void    Z_Lock (void);
+void    Z_Unlock (void);
+
 //
 // This is used to get the local FILE:LINE info from CPP
 // prior to really call the function in question.
 //
+
+#define Z_Malloc(s,t,u)                                        \
+    Z_Malloc2((s), (t), (u), __FILE__, __LINE__)
+
+// Only from free space; NULL if there is none big enough.
+#define Z_TryMalloc(s,t,u)                                     \
+    Z_TryMalloc2((s), (t), (u), __FILE__, __LINE__)
+
 #define Z_ChangeTag(p,t)                                       \
     Z_ChangeTag2((p), (t), __FILE__, __LINE__)
 
 
+//
+// Level lifetime memory, bump allocated outside the zone and
+// released all at once when Z_FreeTags frees PU_LEVEL.
+//
+void*   Z_LevelAlloc (int size);
+
+
+//
+// Slabs of fixed size objects, for things that are created and
+// destroyed often (mobjs, thinkers). Objects are cache line aligned
+// and recycled through a free list. Pages of level slabs come from
+// the level arena, others are zone blocks with the slab's tag; either
+// way Z_FreeTags releases them in bulk and empties the slab.
+//
+
+typedef struct zslab_s
+{
+    int                 size;           // object size
+    int                 tag;            // tag of the zone pages
+    int                 stride;         // bytes between objects
+    void*               freelist;
+    byte*               bump;           // next unused object in last page
+    byte*               bumpend;
+    struct zslab_s*     next;           // next slab known to the zone
+    boolean             registered;
+} zslab_t;
+
+#define Z_SLAB(type, tag)                                      \
+    { sizeof(type), (tag), 0, NULL, NULL, NULL, NULL, false }
+
+void*   Z_SlabAlloc (zslab_t *slab);
+void    Z_SlabFree (void *ptr);
+zslab_t* Z_SlabOf (void *ptr);
+
+
 #endif
@@ -0,0 +1,184 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Check FixedDiv in app/src/main/cpp/m_fixed.c against the plain
+//	64-bit integer division it replaces, and time the two.
+//
+//	    cc -O2 -DFIXEDDIV_DOUBLE -I../app/src/main/cpp -o fixedtest
+//	        fixedtest.c ../app/src/main/cpp/m_fixed.c
+//	    fixedtest [random pairs]
+//
+//	Without -DFIXEDDIV_DOUBLE the engine's own choice for the target
+//	is tested; build with -m32, or for armeabi-v7a, to test what the
+//	watch runs.  Dividends near every power of two are tried against
+//	divisors near every power of two, then random pairs (100 million
+//	by default).  The exit status is 1 on any difference.
+//
+//	The timings only mean something on a 32-bit target: on x86-64
+//	the 64-bit integer division is a single instruction.
+//
+//	INT_MIN is left out.  abs() overflows on it, so it never reaches
+//	the floating point division, and what the integer division makes
+//	of it depends on how the compiler treats the overflow.
+//
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "m_fixed.h"
+
+// The division FixedDiv must match, bit for bit.
+
+static fixed_t RefFixedDiv(fixed_t a, fixed_t b)
+{
+    if ((abs(a) >> 14) >= abs(b))
+        return (a ^ b) < 0 ? INT_MIN : INT_MAX;
+
+    return (fixed_t) (((int64_t) a << 16) / b);
+}
+
+static unsigned long long rngstate = 88172645463325252ULL;
+
+static unsigned int Random32(void)
+{
+    rngstate ^= rngstate << 13;
+    rngstate ^= rngstate >> 7;
+    rngstate ^= rngstate << 17;
+
+    return (unsigned int) (rngstate >> 32);
+}
+
+// Values that sit on the edges: around powers of two, and zero.
+
+static int EdgeValue(unsigned int r)
+{
+    int shift = r % 31;
+    int delta = (int) ((r >> 5) % 5) - 2;
+    int value = (1 << shift) + delta;
+
+    return (r & 0x80000) ? -value : value;
+}
+
+static long long mismatches;
+
+static void Check(fixed_t a, fixed_t b)
+{
+    fixed_t got, want;
+
+    if (b == 0 || a == INT_MIN || b == INT_MIN)
+        return;
+
+    got = FixedDiv(a, b);
+    want = RefFixedDiv(a, b);
+
+    if (got != want)
+    {
+        if (mismatches < 20)
+        {
+            printf("FixedDiv(%i, %i) = %i, should be %i\n",
+                   a, b, got, want);
+        }
+
+        ++mismatches;
+    }
+}
+
+static double Time(fixed_t (*func)(fixed_t, fixed_t),
+                   const fixed_t *a, const fixed_t *b, int n,
+                   volatile fixed_t *sink)
+{
+    clock_t start;
+    fixed_t sum = 0;
+    int pass, i;
+
+    start = clock();
+
+    for (pass = 0; pass < 20; ++pass)
+    {
+        for (i = 0; i < n; ++i)
+            sum += func(a[i], b[i]);
+    }
+
+    *sink = sum;
+
+    return (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / (20.0 * n);
+}
+
+#define BENCHPAIRS  (1 << 16)
+
+int main(int argc, char **argv)
+{
+    static fixed_t ba[BENCHPAIRS], bb[BENCHPAIRS];
+    volatile fixed_t sink;
+    long long count, i;
+    long long checked = 0;
+    unsigned int r;
+    int j;
+
+    count = argc > 1 ? atoll(argv[1]) : 100000000LL;
+
+    // Edge dividends against edge divisors, both signs, and the
+    // largest values.
+
+    for (r = 0; r < (1u << 20); ++r)
+    {
+        int a = EdgeValue(r);
+
+        for (j = 0; j < 31 * 5; ++j)
+        {
+            int b = EdgeValue(j * 32 + (j % 5) + (r & 0x80000));
+
+            Check(a, b);
+            Check(a, -b);
+            checked += 2;
+        }
+
+        Check(a, INT_MAX);
+        Check(INT_MAX, a);
+        Check(a, INT_MIN + 1);
+        Check(INT_MIN + 1, a);
+        checked += 4;
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        fixed_t a = (fixed_t) Random32();
+        fixed_t b = (fixed_t) Random32();
+
+        // Most random pairs overflow; shrink the divisor often so
+        // the division itself gets tested.
+        if (i & 1)
+            b >>= Random32() % 31;
+
+        Check(a, b);
+        ++checked;
+    }
+
+    printf("%lld pairs checked, %lld differ\n", checked, mismatches);
+
+    for (j = 0; j < BENCHPAIRS; ++j)
+    {
+        ba[j] = (fixed_t) Random32() >> (Random32() % 8);
+        bb[j] = ((fixed_t) Random32() >> 8) | 1;
+    }
+
+    printf("FixedDiv %.2f ns, 64-bit integer %.2f ns\n",
+           Time(FixedDiv, ba, bb, BENCHPAIRS, &sink),
+           Time(RefFixedDiv, ba, bb, BENCHPAIRS, &sink));
+
+    return mismatches > 0;
+}
+
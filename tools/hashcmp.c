@@ -0,0 +1,345 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Compare two state hash streams, as written with -statehash by
+//	app/src/main/cpp/p_hash.c (which describes the layout), and
+//	report the first tic where they differ and what differs in it.
+//
+//	    cc -O2 -o hashcmp hashcmp.c
+//	    hashcmp before.sth after.sth
+//
+//	The exit status is 0 if the streams match, 1 if not.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STATEHASH_VERSION   1
+
+// Objects listed for each group at the first difference.
+#define MAXREPORTED         10
+
+enum
+{
+    PLAYERS,
+    MOBJS,
+    SECTORS,
+    NUMGROUPS
+};
+
+static const char *groupnames[NUMGROUPS] = { "player", "mobj", "sector" };
+
+typedef struct
+{
+    unsigned int hash;
+    int type;
+    int x, y;
+} object_t;
+
+typedef struct
+{
+    object_t *objects;
+    int count;
+    int alloced;
+} group_t;
+
+typedef struct
+{
+    const char *name;
+    FILE *f;
+    int tic;
+    int prndindex;
+    int truncated;
+    group_t groups[NUMGROUPS];
+} stream_t;
+
+static int ReadByte(stream_t *s)
+{
+    int c = getc(s->f);
+
+    if (c == EOF)
+        s->truncated = 1;
+
+    return c;
+}
+
+static unsigned int ReadVar(stream_t *s)
+{
+    unsigned int value = 0;
+    int shift = 0;
+    int c;
+
+    do
+    {
+        c = ReadByte(s);
+
+        if (c == EOF)
+            return 0;
+
+        value |= (unsigned int) (c & 0x7f) << shift;
+        shift += 7;
+    } while ((c & 0x80) && shift < 32);
+
+    return value;
+}
+
+static int ReadShort(stream_t *s)
+{
+    int lo = ReadByte(s);
+    int hi = ReadByte(s);
+
+    return (short) ((lo & 0xff) | ((hi & 0xff) << 8));
+}
+
+static unsigned int ReadLong(stream_t *s)
+{
+    unsigned int lo = ReadShort(s) & 0xffff;
+    unsigned int hi = ReadShort(s) & 0xffff;
+
+    return lo | (hi << 16);
+}
+
+static void OpenStream(stream_t *s, const char *name)
+{
+    char id[4];
+
+    memset(s, 0, sizeof(*s));
+    s->name = name;
+    s->f = fopen(name, "rb");
+
+    if (s->f == NULL)
+    {
+        perror(name);
+        exit(2);
+    }
+
+    if (fread(id, 1, 4, s->f) != 4 || memcmp(id, "STHS", 4)
+     || getc(s->f) != STATEHASH_VERSION)
+    {
+        fprintf(stderr, "%s: not a version %i state hash stream\n",
+                name, STATEHASH_VERSION);
+        exit(2);
+    }
+}
+
+static void ReadGroup(stream_t *s, group_t *group, int mobjs)
+{
+    unsigned int count, changed, i, index;
+
+    count = ReadVar(s);
+    changed = ReadVar(s);
+
+    if (count > 1000000 || changed > count)
+    {
+        s->truncated = 1;
+        return;
+    }
+
+    if ((int) count > group->alloced)
+    {
+        group->alloced = count * 2;
+        group->objects = realloc(group->objects,
+                                 group->alloced * sizeof(object_t));
+
+        if (group->objects == NULL)
+        {
+            fprintf(stderr, "%s: out of memory\n", s->name);
+            exit(2);
+        }
+    }
+
+    // Objects new since the tic before are all in the changed list.
+    group->count = count;
+
+    for (i = 0; i < changed && !s->truncated; ++i)
+    {
+        object_t obj;
+
+        index = ReadVar(s);
+        obj.hash = ReadLong(s);
+        obj.type = -1;
+        obj.x = obj.y = 0;
+
+        if (mobjs)
+        {
+            obj.type = ReadVar(s);
+            obj.x = ReadShort(s);
+            obj.y = ReadShort(s);
+        }
+
+        if (index >= count)
+        {
+            s->truncated = 1;
+            return;
+        }
+
+        group->objects[index] = obj;
+    }
+}
+
+//
+// Read the next tic. Returns 0 at the end of the stream, which may
+// be part way through a tic if the game that wrote it crashed.
+//
+static int ReadTic(stream_t *s)
+{
+    int c;
+    int i;
+
+    c = getc(s->f);
+
+    if (c == EOF)
+        return 0;
+
+    ungetc(c, s->f);
+
+    s->tic = ReadVar(s);
+    s->prndindex = ReadByte(s);
+
+    for (i = 0; i < NUMGROUPS; ++i)
+        ReadGroup(s, &s->groups[i], i == MOBJS);
+
+    return !s->truncated;
+}
+
+static void PrintObject(object_t *obj)
+{
+    if (obj->type >= 0)
+        printf("type %i at (%i, %i)", obj->type, obj->x, obj->y);
+    else
+        printf("%08x", obj->hash);
+}
+
+static int GroupsDiffer(group_t *a, group_t *b)
+{
+    int i;
+
+    if (a->count != b->count)
+        return 1;
+
+    for (i = 0; i < a->count; ++i)
+    {
+        if (a->objects[i].hash != b->objects[i].hash)
+            return 1;
+    }
+
+    return 0;
+}
+
+static void ReportGroup(stream_t *a, stream_t *b, int g)
+{
+    group_t *ga = &a->groups[g], *gb = &b->groups[g];
+    int count = ga->count < gb->count ? ga->count : gb->count;
+    int reported = 0, more = 0;
+    int i;
+
+    if (ga->count != gb->count)
+    {
+        printf("  %ss: %i in %s, %i in %s\n", groupnames[g],
+               ga->count, a->name, gb->count, b->name);
+    }
+
+    for (i = 0; i < count; ++i)
+    {
+        if (ga->objects[i].hash == gb->objects[i].hash)
+            continue;
+
+        if (reported == MAXREPORTED)
+        {
+            ++more;
+            continue;
+        }
+
+        printf("  %s %i: ", groupnames[g], i);
+        PrintObject(&ga->objects[i]);
+        printf(" / ");
+        PrintObject(&gb->objects[i]);
+        printf("\n");
+        ++reported;
+    }
+
+    if (more > 0)
+        printf("  ... and %i more %ss\n", more, groupnames[g]);
+}
+
+int main(int argc, char **argv)
+{
+    stream_t a, b;
+    int tics, ra, rb;
+    int differ;
+    int i;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <a.sth> <b.sth>\n", argv[0]);
+        return 2;
+    }
+
+    OpenStream(&a, argv[1]);
+    OpenStream(&b, argv[2]);
+
+    for (tics = 0; ; ++tics)
+    {
+        ra = ReadTic(&a);
+        rb = ReadTic(&b);
+
+        if (!ra || !rb)
+            break;
+
+        if (a.tic != b.tic)
+        {
+            printf("Out of step after %i tics: tic %i in %s, "
+                   "tic %i in %s\n", tics, a.tic, a.name, b.tic, b.name);
+            return 1;
+        }
+
+        differ = a.prndindex != b.prndindex;
+
+        for (i = 0; i < NUMGROUPS; ++i)
+            differ |= GroupsDiffer(&a.groups[i], &b.groups[i]);
+
+        if (!differ)
+            continue;
+
+        printf("First difference at tic %i, after %i matching tics "
+               "(%s / %s):\n", a.tic, tics, a.name, b.name);
+
+        if (a.prndindex != b.prndindex)
+        {
+            printf("  P_Random index: %i / %i\n",
+                   a.prndindex, b.prndindex);
+        }
+
+        for (i = 0; i < NUMGROUPS; ++i)
+            ReportGroup(&a, &b, i);
+
+        return 1;
+    }
+
+    if (ra != rb || a.truncated || b.truncated)
+    {
+        stream_t *shorter = ra || b.truncated ? &b : &a;
+
+        printf("%s ends%s after %i tics; the other goes on\n",
+               shorter->name, shorter->truncated ? " part way" : "",
+               tics);
+        return 1;
+    }
+
+    printf("%i tics match\n", tics);
+
+    return 0;
+}
+
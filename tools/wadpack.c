@@ -0,0 +1,300 @@
+//
+// Copyright(C) 2005-2014 Simon Howard
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Pack a WAD into the compressed container read by
+//	app/src/main/cpp/w_file_lz4.c, which describes the layout.
+//
+//	    cc -O2 -o wadpack wadpack.c
+//	    wadpack doom1.wad doom1.wad.lz4
+//
+//	The output can be used in place of the WAD under its old name.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HASHBITS        16
+#define MINMATCH        4
+#define MAXOFFSET       65535
+
+// The format requires the last match to start at least 12 bytes
+// from the end, and the last 5 bytes to be literals.
+#define MFLIMIT         12
+#define LASTLITERALS    5
+
+typedef struct
+{
+    unsigned int offset;
+    unsigned int size;
+    unsigned int fileofs;
+    unsigned int packedsize;
+} block_t;
+
+static unsigned int ReadLong(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+static void WriteLong(FILE *f, unsigned int value)
+{
+    fputc(value & 0xff, f);
+    fputc((value >> 8) & 0xff, f);
+    fputc((value >> 16) & 0xff, f);
+    fputc((value >> 24) & 0xff, f);
+}
+
+static unsigned char *WriteLength(unsigned char *op, int length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+
+    *op++ = length;
+
+    return op;
+}
+
+//
+// Compress src into the LZ4 block format: greedy, with a hash of the
+// last place each four bytes were seen. dest must hold at least
+// len + len / 255 + 16 bytes. Returns the compressed length.
+//
+static int Compress(const unsigned char *src, int len, unsigned char *dest)
+{
+    static int hash[1 << HASHBITS];
+    unsigned char *op = dest;
+    int ip, anchor, litlen, mlen, ref;
+
+    memset(hash, 0xff, sizeof(hash));
+
+    ip = 0;
+    anchor = 0;
+
+    while (ip < len - MFLIMIT)
+    {
+        unsigned int seq = ReadLong(src + ip);
+        unsigned int h = (seq * 2654435761u) >> (32 - HASHBITS);
+
+        ref = hash[h];
+        hash[h] = ip;
+
+        if (ref < 0 || ip - ref > MAXOFFSET || ReadLong(src + ref) != seq)
+        {
+            ++ip;
+            continue;
+        }
+
+        mlen = MINMATCH;
+
+        while (ip + mlen < len - LASTLITERALS && src[ref + mlen] == src[ip + mlen])
+            ++mlen;
+
+        litlen = ip - anchor;
+
+        *op++ = ((litlen < 15 ? litlen : 15) << 4)
+              | (mlen - MINMATCH < 15 ? mlen - MINMATCH : 15);
+
+        if (litlen >= 15)
+            op = WriteLength(op, litlen - 15);
+
+        memcpy(op, src + anchor, litlen);
+        op += litlen;
+
+        *op++ = (ip - ref) & 0xff;
+        *op++ = (ip - ref) >> 8;
+
+        if (mlen - MINMATCH >= 15)
+            op = WriteLength(op, mlen - MINMATCH - 15);
+
+        ip += mlen;
+        anchor = ip;
+    }
+
+    // Last literals
+
+    litlen = len - anchor;
+    *op++ = (litlen < 15 ? litlen : 15) << 4;
+
+    if (litlen >= 15)
+        op = WriteLength(op, litlen - 15);
+
+    memcpy(op, src + anchor, litlen);
+    op += litlen;
+
+    return op - dest;
+}
+
+static int CompareOffsets(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a;
+    unsigned int y = *(const unsigned int *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void AddCut(unsigned int *cuts, int *numcuts, unsigned int offset,
+                   unsigned int length)
+{
+    cuts[(*numcuts)++] = offset < length ? offset : length;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char *wad, *packed;
+    unsigned int length, numlumps, infotableofs;
+    unsigned int *cuts;
+    unsigned int packedtotal;
+    block_t *blocks;
+    int numcuts, numblocks;
+    FILE *f;
+    int i, n;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <in.wad> <out>\n", argv[0]);
+        return 1;
+    }
+
+    f = fopen(argv[1], "rb");
+
+    if (f == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    wad = malloc(length + 1);
+
+    if (wad == NULL || fread(wad, 1, length, f) != length || length < 12
+     || (memcmp(wad, "IWAD", 4) && memcmp(wad, "PWAD", 4)))
+    {
+        fprintf(stderr, "%s: not a WAD file\n", argv[1]);
+        return 1;
+    }
+
+    fclose(f);
+
+    numlumps = ReadLong(wad + 4);
+    infotableofs = ReadLong(wad + 8);
+
+    if (infotableofs > length || numlumps > (length - infotableofs) / 16)
+    {
+        fprintf(stderr, "%s: damaged directory\n", argv[1]);
+        return 1;
+    }
+
+    // Cut the WAD at the start and end of everything in it, so
+    // every lump is a block of its own.
+
+    cuts = malloc((numlumps * 2 + 5) * sizeof(unsigned int));
+    numcuts = 0;
+
+    AddCut(cuts, &numcuts, 0, length);
+    AddCut(cuts, &numcuts, 12, length);
+    AddCut(cuts, &numcuts, infotableofs, length);
+    AddCut(cuts, &numcuts, infotableofs + numlumps * 16, length);
+    AddCut(cuts, &numcuts, length, length);
+
+    for (i = 0; i < (int) numlumps; ++i)
+    {
+        const unsigned char *entry = wad + infotableofs + i * 16;
+        unsigned int filepos = ReadLong(entry);
+        unsigned int size = ReadLong(entry + 4);
+
+        AddCut(cuts, &numcuts, filepos, length);
+        AddCut(cuts, &numcuts, filepos + size, length);
+    }
+
+    qsort(cuts, numcuts, sizeof(unsigned int), CompareOffsets);
+
+    blocks = malloc(numcuts * sizeof(block_t));
+    packed = malloc(length + length / 255 + 16);
+    numblocks = 0;
+
+    f = fopen(argv[2], "wb");
+
+    if (f == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    // Header, finished once the table's place is known
+
+    fwrite("WLZ4", 1, 4, f);
+    WriteLong(f, length);
+    WriteLong(f, 0);
+    WriteLong(f, 0);
+
+    packedtotal = 16;
+
+    for (i = 0; i + 1 < numcuts; ++i)
+    {
+        block_t *block;
+
+        if (cuts[i + 1] == cuts[i])
+            continue;
+
+        block = &blocks[numblocks++];
+        block->offset = cuts[i];
+        block->size = cuts[i + 1] - cuts[i];
+        block->fileofs = packedtotal;
+
+        n = Compress(wad + block->offset, block->size, packed);
+
+        if ((unsigned int) n < block->size)
+        {
+            block->packedsize = n;
+            fwrite(packed, 1, n, f);
+        }
+        else
+        {
+            block->packedsize = block->size;
+            fwrite(wad + block->offset, 1, block->size, f);
+        }
+
+        packedtotal += block->packedsize;
+    }
+
+    for (i = 0; i < numblocks; ++i)
+    {
+        WriteLong(f, blocks[i].offset);
+        WriteLong(f, blocks[i].size);
+        WriteLong(f, blocks[i].fileofs);
+        WriteLong(f, blocks[i].packedsize);
+    }
+
+    fseek(f, 8, SEEK_SET);
+    WriteLong(f, numblocks);
+    WriteLong(f, packedtotal);
+
+    if (fclose(f) != 0)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    printf("%s: %u bytes in %i blocks packed to %u\n",
+           argv[1], length, numblocks, packedtotal + numblocks * 16);
+
+    return 0;
+}
+